@@ -0,0 +1,718 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include "xivres/excel.h"
+#include "xivres/installation.h"
+#include "xivres/packed_stream.model.h"
+#include "xivres/packed_stream.placeholder.h"
+#include "xivres/packed_stream.standard.h"
+#include "xivres/packed_stream.texture.h"
+#include "xivres/sqpack.generator.h"
+#include "xivres/texture.mipmap_stream.h"
+#include "xivres/unpacked_stream.h"
+#include "xivres/util.dxt.h"
+#include "xivres/util.thread_pool.h"
+
+// Output format version; bump whenever a field is renamed or its meaning changes.
+static constexpr int BenchmarkSchemaVersion = 2;
+
+// Every allocation through the global operator new is counted, and its size is kept in front of it to track live bytes.
+static std::atomic_uint64_t s_allocationCount;
+static std::atomic_uint64_t s_allocatedBytes;
+static std::atomic_uint64_t s_liveBytes;
+static std::atomic_uint64_t s_peakLiveBytes;
+static constexpr size_t AllocationHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* operator new(size_t size) {
+	const auto p = static_cast<uint8_t*>(std::malloc(size + AllocationHeaderSize));
+	if (!p)
+		throw std::bad_alloc();
+
+	*reinterpret_cast<size_t*>(p) = size;
+	s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	const auto live = s_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	for (auto peak = s_peakLiveBytes.load(std::memory_order_relaxed); peak < live && !s_peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed);) {}
+	return p + AllocationHeaderSize;
+}
+
+void operator delete(void* ptr) noexcept {
+	if (!ptr)
+		return;
+
+	const auto p = static_cast<uint8_t*>(ptr) - AllocationHeaderSize;
+	s_liveBytes.fetch_sub(*reinterpret_cast<size_t*>(p), std::memory_order_relaxed);
+	std::free(p);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	operator delete(ptr);
+}
+
+class benchmark_runner {
+public:
+	struct result {
+		std::string Name;
+		uint64_t Iterations{};
+		uint64_t ItemsPerIteration{};
+		uint64_t BytesPerIteration{};
+		std::chrono::nanoseconds Elapsed{};
+		uint64_t Allocations{};
+		uint64_t AllocatedBytes{};
+		uint64_t PeakLiveBytes{};
+	};
+
+private:
+	const std::chrono::nanoseconds m_minDuration;
+	const uint64_t m_maxIterations;
+	std::vector<result> m_results;
+
+public:
+	benchmark_runner(std::chrono::nanoseconds minDuration, uint64_t maxIterations)
+		: m_minDuration(minDuration)
+		, m_maxIterations(maxIterations) {
+	}
+
+	template<typename TFn>
+	void run(std::string name, uint64_t itemsPerIteration, uint64_t bytesPerIteration, TFn&& fn) {
+		std::cerr << std::format("{}...", name);
+		try {
+			fn();  // warm up caches and pools
+
+			result res{
+				.Name = std::move(name),
+				.ItemsPerIteration = itemsPerIteration,
+				.BytesPerIteration = bytesPerIteration,
+			};
+			const auto allocationsBefore = s_allocationCount.load();
+			const auto allocatedBytesBefore = s_allocatedBytes.load();
+			const auto liveBytesBefore = s_liveBytes.load();
+			s_peakLiveBytes = liveBytesBefore;
+
+			const auto begin = std::chrono::steady_clock::now();
+			do {
+				fn();
+				res.Iterations++;
+				res.Elapsed = std::chrono::steady_clock::now() - begin;
+			} while (res.Elapsed < m_minDuration && res.Iterations < m_maxIterations);
+
+			res.Allocations = (s_allocationCount - allocationsBefore) / res.Iterations;
+			res.AllocatedBytes = (s_allocatedBytes - allocatedBytesBefore) / res.Iterations;
+			res.PeakLiveBytes = s_peakLiveBytes - liveBytesBefore;
+
+			std::cerr << std::format(" {} iterations, {:.3f}ms/iter, {} allocations/iter, {:.1f}MiB peak\n",
+				res.Iterations, static_cast<double>(res.Elapsed.count()) / static_cast<double>(res.Iterations) / 1000000.,
+				res.Allocations, static_cast<double>(res.PeakLiveBytes) / 1048576.);
+			m_results.emplace_back(std::move(res));
+		} catch (const std::exception& e) {
+			std::cerr << std::format(" skipped: {}\n", e.what());
+		}
+	}
+
+	void write_json(std::ostream& os) const {
+		os << "{\n";
+		os << std::format("  \"schema\": {},\n", BenchmarkSchemaVersion);
+		os << std::format("  \"pointer_size\": {},\n", sizeof(void*));
+		os << std::format("  \"hardware_concurrency\": {},\n", std::thread::hardware_concurrency());
+		os << "  \"results\": [";
+		for (size_t i = 0; i < m_results.size(); i++) {
+			const auto& r = m_results[i];
+			const auto seconds = static_cast<double>(r.Elapsed.count()) / 1e9;
+			os << (i == 0 ? "\n" : ",\n");
+			os << std::format(
+				"    {{\"name\": \"{}\", \"iterations\": {}, \"items_per_iteration\": {}, \"bytes_per_iteration\": {}, "
+				"\"total_ns\": {}, \"ns_per_iteration\": {:.1f}, \"items_per_second\": {:.1f}, \"bytes_per_second\": {:.1f}, "
+				"\"allocations_per_iteration\": {}, \"allocated_bytes_per_iteration\": {}, \"peak_live_bytes\": {}}}",
+				r.Name, r.Iterations, r.ItemsPerIteration, r.BytesPerIteration,
+				r.Elapsed.count(),
+				static_cast<double>(r.Elapsed.count()) / static_cast<double>(r.Iterations),
+				seconds > 0 ? static_cast<double>(r.ItemsPerIteration * r.Iterations) / seconds : 0.,
+				seconds > 0 ? static_cast<double>(r.BytesPerIteration * r.Iterations) / seconds : 0.,
+				r.Allocations, r.AllocatedBytes, r.PeakLiveBytes);
+		}
+		os << "\n  ]\n}\n";
+	}
+};
+
+static const char* packed_type_name(xivres::packed::type type) {
+	switch (type) {
+		case xivres::packed::type::standard: return "standard";
+		case xivres::packed::type::model: return "model";
+		case xivres::packed::type::texture: return "texture";
+		default: return "other";
+	}
+}
+
+static std::filesystem::path index_path_of(const std::filesystem::path& gamePath, uint32_t packId) {
+	const auto expacId = (packId >> 8) & 0xFF;
+	if (expacId == 0)
+		return gamePath / std::format("sqpack/ffxiv/{:0>6x}.win32.index", packId);
+	else
+		return gamePath / std::format("sqpack/ex{}/{:0>6x}.win32.index", expacId, packId);
+}
+
+struct sample_entry {
+	const xivres::sqpack::reader* Reader;
+	const xivres::sqpack::reader::entry_info* Entry;
+	xivres::packed::type Type;
+	std::vector<uint8_t> Unpacked;
+};
+
+// Picks the first entries of each packed type in pack order, so that the same installation always yields the same sample set.
+static std::vector<sample_entry> collect_samples(const xivres::installation& gameReader, size_t countPerType, size_t minUnpackedSize) {
+	std::vector<sample_entry> res;
+	std::map<xivres::packed::type, size_t> counts;
+	for (const auto packId : gameReader.get_sqpack_ids()) {
+		const auto& packfile = gameReader.get_sqpack(packId);
+		for (const auto& entry : packfile.Entries) {
+			try {
+				const auto packed = packfile.packed_at(entry);
+				const auto type = packed->get_packed_type();
+				if (type != xivres::packed::type::standard && type != xivres::packed::type::model && type != xivres::packed::type::texture)
+					continue;
+				if (counts[type] >= countPerType)
+					continue;
+
+				auto unpacked = xivres::unpacked_stream(packed).read_vector<uint8_t>();
+				if (unpacked.size() < minUnpackedSize)
+					continue;
+
+				counts[type]++;
+				res.emplace_back(&packfile, &entry, type, std::move(unpacked));
+			} catch (const std::exception&) {
+				// pass
+			}
+		}
+
+		if (counts.size() == 3 && std::ranges::all_of(counts, [countPerType](const auto& p) { return p.second >= countPerType; }))
+			break;
+	}
+	return res;
+}
+
+static void bench_reader(benchmark_runner& runner, const xivres::installation& gameReader, const std::filesystem::path& gamePath, std::span<const uint32_t> packIds) {
+	for (const auto packId : packIds) {
+		const auto indexPath = index_path_of(gamePath, packId);
+		if (!exists(indexPath))
+			continue;
+
+		runner.run(std::format("reader/from_path/{:06x}", packId), 1, file_size(indexPath), [&indexPath] {
+			(void)xivres::sqpack::reader::from_path(indexPath);
+		});
+
+		const auto& packfile = gameReader.get_sqpack(packId);
+		runner.run(std::format("reader/find_data_locator_from_index1/{:06x}", packId), packfile.Entries.size(), 0, [&packfile] {
+			size_t found = 0;
+			for (const auto& entry : packfile.Entries)
+				found += packfile.find_data_locator_from_index1(entry.PathSpec) ? 1 : 0;
+			if (!found)
+				throw std::runtime_error("No entry found");
+		});
+		runner.run(std::format("reader/find_data_locator_from_index2/{:06x}", packId), packfile.Entries.size(), 0, [&packfile] {
+			size_t found = 0;
+			for (const auto& entry : packfile.Entries)
+				found += packfile.find_data_locator_from_index2(entry.PathSpec) ? 1 : 0;
+			if (!found)
+				throw std::runtime_error("No entry found");
+		});
+	}
+}
+
+static void bench_unpack(benchmark_runner& runner, std::span<const sample_entry> samples) {
+	std::vector<uint8_t> buf;
+	for (const auto type : {xivres::packed::type::standard, xivres::packed::type::model, xivres::packed::type::texture}) {
+		uint64_t totalBytes = 0;
+		std::vector<const sample_entry*> typed;
+		for (const auto& sample : samples) {
+			if (sample.Type == type) {
+				typed.emplace_back(&sample);
+				totalBytes += sample.Unpacked.size();
+			}
+		}
+		if (typed.empty())
+			continue;
+
+		for (const size_t requestSize : {size_t{256}, size_t{4096}, size_t{65536}, size_t{1048576}}) {
+			buf.resize(requestSize);
+			runner.run(std::format("unpacked_stream/read/{}/{}", packed_type_name(type), requestSize), typed.size(), totalBytes, [&typed, &buf] {
+				for (const auto sample : typed) {
+					const auto unpacked = sample->Reader->at(*sample->Entry);
+					const auto size = unpacked->size();
+					for (std::streamoff offset = 0; offset < size; offset += static_cast<std::streamoff>(buf.size()))
+						unpacked->read(offset, buf.data(), static_cast<std::streamsize>(buf.size()));
+				}
+			});
+		}
+
+		runner.run(std::format("unpacked_stream/read/{}/full", packed_type_name(type)), typed.size(), totalBytes, [&typed] {
+			for (const auto sample : typed)
+				(void)sample->Reader->at(*sample->Entry)->read_vector<uint8_t>();
+		});
+	}
+}
+
+template<typename TPacker>
+static void bench_pack_one(benchmark_runner& runner, std::span<const sample_entry> samples, xivres::packed::type type, int level, bool multithreaded) {
+	std::vector<std::pair<xivres::path_spec, std::shared_ptr<xivres::memory_stream>>> sources;
+	uint64_t totalBytes = 0;
+	for (const auto& sample : samples) {
+		if (sample.Type == type) {
+			sources.emplace_back(sample.Entry->PathSpec, std::make_shared<xivres::memory_stream>(std::span(sample.Unpacked)));
+			totalBytes += sample.Unpacked.size();
+		}
+	}
+	if (sources.empty())
+		return;
+
+	runner.run(std::format("compressing_packed_stream/{}/level{}/{}", packed_type_name(type), level, multithreaded ? "mt" : "st"), sources.size(), totalBytes, [&sources, level, multithreaded] {
+		for (const auto& [pathSpec, source] : sources)
+			(void)xivres::compressing_packed_stream<TPacker>(pathSpec, source, level, multithreaded).size();
+	});
+}
+
+static void bench_pack(benchmark_runner& runner, std::span<const sample_entry> samples) {
+	for (const auto level : {Z_BEST_SPEED, Z_BEST_COMPRESSION}) {
+		for (const auto multithreaded : {false, true}) {
+			bench_pack_one<xivres::standard_compressing_packer>(runner, samples, xivres::packed::type::standard, level, multithreaded);
+			bench_pack_one<xivres::model_compressing_packer>(runner, samples, xivres::packed::type::model, level, multithreaded);
+			bench_pack_one<xivres::texture_compressing_packer>(runner, samples, xivres::packed::type::texture, level, multithreaded);
+		}
+	}
+}
+
+static void bench_incompressible(benchmark_runner& runner, std::span<const sample_entry> samples) {
+	const auto defaultThreshold = xivres::compressing_packer::incompressible_entropy_threshold();
+	for (const auto threshold : {8., defaultThreshold}) {
+		xivres::compressing_packer::incompressible_entropy_threshold(threshold);
+		xivres::compressing_packer::reset_incompressible_statistics();
+
+		std::vector<const sample_entry*> sources;
+		uint64_t totalBytes = 0;
+		for (const auto& sample : samples) {
+			if (sample.Type == xivres::packed::type::standard || sample.Type == xivres::packed::type::texture) {
+				sources.emplace_back(&sample);
+				totalBytes += sample.Unpacked.size();
+			}
+		}
+
+		runner.run(std::format("compressing_packer/entropy{:.2f}", threshold), sources.size(), totalBytes, [&sources] {
+			for (const auto sample : sources) {
+				const auto source = std::make_shared<xivres::memory_stream>(std::span(sample->Unpacked));
+				if (sample->Type == xivres::packed::type::texture)
+					(void)xivres::compressing_packed_stream<xivres::texture_compressing_packer>(sample->Entry->PathSpec, source, Z_BEST_COMPRESSION, false).size();
+				else
+					(void)xivres::compressing_packed_stream<xivres::standard_compressing_packer>(sample->Entry->PathSpec, source, Z_BEST_COMPRESSION, false).size();
+			}
+		});
+
+		const auto stats = xivres::compressing_packer::incompressible_statistics();
+		std::cerr << std::format("  {}/{} blocks stored raw, ~{}ms of deflate saved, ~{} bytes lost\n",
+			stats.SkippedBlockCount, stats.ProbedBlockCount,
+			std::chrono::duration_cast<std::chrono::milliseconds>(stats.estimated_time_saved()).count(),
+			stats.estimated_bytes_lost());
+	}
+	xivres::compressing_packer::incompressible_entropy_threshold(defaultThreshold);
+}
+
+static void bench_export(benchmark_runner& runner, std::span<const sample_entry> samples, const std::filesystem::path& tempDir) {
+	const auto populate = [&samples](xivres::sqpack::generator& generator) {
+		for (const auto& sample : samples)
+			generator.add(sample.Reader->packed_at(*sample.Entry));
+	};
+
+	uint64_t totalBytes = 0;
+	for (const auto& sample : samples)
+		totalBytes += sample.Reader->packed_at(*sample.Entry)->size();
+
+	for (const auto strict : {false, true}) {
+		runner.run(std::format("generator/export_to_views/{}", strict ? "strict" : "fast"), samples.size(), totalBytes, [&populate, strict] {
+			xivres::sqpack::generator generator("ffxiv", "0f0000");
+			populate(generator);
+			const auto views = generator.export_to_views(strict);
+			std::vector<uint8_t> buf(1048576);
+			for (const auto& data : views.Data) {
+				const auto size = data->size();
+				for (std::streamoff offset = 0; offset < size; offset += static_cast<std::streamoff>(buf.size()))
+					data->read(offset, buf.data(), static_cast<std::streamsize>(buf.size()));
+			}
+		});
+
+		runner.run(std::format("generator/export_to_files/{}", strict ? "strict" : "fast"), samples.size(), totalBytes, [&populate, &tempDir, strict] {
+			xivres::sqpack::generator generator("ffxiv", "0f0000");
+			populate(generator);
+			generator.export_to_files(tempDir, strict);
+		});
+	}
+
+	runner.run("generator/export_to_files/dedup", samples.size(), totalBytes, [&populate, &tempDir] {
+		xivres::sqpack::generator generator("ffxiv", "0f0000");
+		generator.set_deduplicate(true);
+		populate(generator);
+		generator.export_to_files(tempDir);
+	});
+	remove_all(tempDir);
+
+	// Readers each take every threadCount-th 4KiB piece, so that every entry gets read piecewise by all threads at once.
+	const auto threadCount = (std::max)(2u, std::thread::hardware_concurrency());
+	for (const auto cached : {false, true}) {
+		runner.run(std::format("generator/views_parallel_read/{}", cached ? "cached" : "uncached"), samples.size(), totalBytes, [&populate, threadCount, cached] {
+			xivres::sqpack::generator generator("ffxiv", "0f0000");
+			populate(generator);
+			const auto cache = cached ? std::make_shared<xivres::sqpack::generator::sqpack_view_entry_cache>() : nullptr;
+			const auto views = generator.export_to_views(false, cache);
+
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < threadCount; i++) {
+				threads.emplace_back([&views, i, threadCount] {
+					std::vector<uint8_t> buf(4096);
+					for (const auto& data : views.Data) {
+						const auto size = data->size();
+						for (auto offset = static_cast<std::streamoff>(i * buf.size()); offset < size; offset += static_cast<std::streamoff>(threadCount * buf.size()))
+							data->read(offset, buf.data(), static_cast<std::streamsize>(buf.size()));
+					}
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+		});
+	}
+}
+
+static void bench_generator_entries(benchmark_runner& runner, size_t count) {
+	// Providers are made beforehand, so that only the bookkeeping of the generator gets measured.
+	std::mt19937 rng(0x78697672);
+	std::vector<std::shared_ptr<xivres::packed_stream>> providers;
+	providers.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		auto pathSpec = i % 10 == 0
+			? xivres::path_spec(static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng()), 4, 0, 0)
+			: xivres::path_spec(std::format("chara/equipment/e{:04}/texture/v{:02}_c0101e{:04}_{:06}_n.tex", i / 1000 % 10000, i % 100, i % 10000, i));
+		providers.emplace_back(std::make_shared<xivres::placeholder_packed_stream>(std::move(pathSpec)));
+	}
+
+	const auto name = std::format("generator/{}k", count / 1000);
+	runner.run(name + "/add", count, 0, [&providers] {
+		xivres::sqpack::generator generator("ffxiv", "040000");
+		for (const auto& provider : providers)
+			generator.add(provider);
+	});
+
+	runner.run(name + "/export_to_views", count, 0, [&providers] {
+		xivres::sqpack::generator generator("ffxiv", "040000");
+		for (const auto& provider : providers)
+			generator.add(provider);
+		(void)generator.export_to_views(false);
+	});
+}
+
+static void bench_thread_pool(benchmark_runner& runner) {
+	// Tasks do next to nothing, so that the time spent is mostly in scheduling.
+	static constexpr size_t TaskCount = 100000;
+	static constexpr size_t ChildCount = 100;
+	std::atomic_uint64_t sink;
+	const auto tiny = [&sink](xivres::util::thread_pool::base_task&) { sink += 1; };
+
+	std::vector<size_t> concurrencies{1, 2, 4};
+	if (const auto hw = std::thread::hardware_concurrency(); hw > 4)
+		concurrencies.emplace_back(hw);
+
+	for (const auto concurrency : concurrencies) {
+		xivres::util::thread_pool::pool pool(concurrency);
+
+		runner.run(std::format("thread_pool/external/{}", concurrency), TaskCount, 0, [&] {
+			xivres::util::thread_pool::task_waiter waiter(pool);
+			for (size_t i = 0; i < TaskCount; i++)
+				waiter.submit(tiny);
+			while (waiter.get()) {}
+		});
+
+		runner.run(std::format("thread_pool/nested/{}", concurrency), TaskCount, 0, [&] {
+			xivres::util::thread_pool::task_waiter waiter(pool);
+			for (size_t i = 0; i < TaskCount / ChildCount; i++) {
+				waiter.submit([&](xivres::util::thread_pool::base_task&) {
+					xivres::util::thread_pool::task_waiter children(pool);
+					for (size_t j = 0; j < ChildCount; j++)
+						children.submit(tiny);
+					while (children.get()) {}
+				});
+			}
+			while (waiter.get()) {}
+		});
+	}
+}
+
+static void bench_object_pool(benchmark_runner& runner) {
+	// Every thread takes and returns objects of the same pool in a tight loop, so that the time spent is mostly contention.
+	static constexpr size_t OperationsPerThread = 1000000;
+
+	std::vector<size_t> threadCounts{1, 2, 4};
+	if (const auto hw = std::thread::hardware_concurrency(); hw > 4)
+		threadCounts.emplace_back(hw);
+
+	const auto run_threads = [](size_t threadCount, const auto& fn) {
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threadCount; i++)
+			threads.emplace_back(fn);
+		for (auto& thread : threads)
+			thread.join();
+	};
+
+	for (const auto threadCount : threadCounts) {
+		xivres::util::thread_pool::object_pool<std::vector<uint8_t>> pool;
+		runner.run(std::format("object_pool/take_return/{}", threadCount), OperationsPerThread * threadCount, 0, [&] {
+			run_threads(threadCount, [&] {
+				for (size_t i = 0; i < OperationsPerThread; i++) {
+					auto object = *pool;
+					if (!object)
+						object.emplace(64);
+				}
+			});
+		});
+
+		runner.run(std::format("object_pool/pooled_byte_buffer/{}", threadCount), OperationsPerThread * threadCount, 0, [&] {
+			run_threads(threadCount, [] {
+				for (size_t i = 0; i < OperationsPerThread; i++) {
+					auto buffer = xivres::util::thread_pool::pooled_byte_buffer();
+					if (!buffer)
+						buffer.emplace(64);
+				}
+			});
+		});
+	}
+}
+
+static void bench_dxt(benchmark_runner& runner) {
+	static constexpr size_t Width = 2048;
+	static constexpr size_t Height = 2048;
+
+	// Random blocks exercise every color/alpha interpolation path, and a fixed seed keeps runs comparable.
+	std::mt19937 rng(0x78697672);
+	std::vector<uint8_t> blocks(Width * Height);
+	for (auto& b : blocks)
+		b = static_cast<uint8_t>(rng());
+
+	const auto dxt1 = xivres::texture::memory_mipmap_stream(Width, Height, 1, xivres::texture::formats::DXT1, std::vector(blocks.begin(), blocks.begin() + Width * Height / 2));
+	const auto dxt3 = xivres::texture::memory_mipmap_stream(Width, Height, 1, xivres::texture::formats::DXT3, blocks);
+	const auto dxt5 = xivres::texture::memory_mipmap_stream(Width, Height, 1, xivres::texture::formats::DXT5, blocks);
+	const auto bc5 = xivres::texture::memory_mipmap_stream(Width, Height, 1, xivres::texture::formats::BC5, blocks);
+	const auto bc7 = xivres::texture::memory_mipmap_stream(Width, Height, 1, xivres::texture::formats::BC7, blocks);
+	std::vector<xivres::util::b8g8r8a8> image(Width * Height);
+
+	runner.run("dxt/BlockDecompressImageDXT1", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageDXT1(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/BlockDecompressImageDXT3", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageDXT3(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/BlockDecompressImageDXT5", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageDXT5(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/BlockDecompressImageBC4", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageBC4(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/BlockDecompressImageBC5", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageBC5(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/BlockDecompressImageBC7", Width * Height, Width * Height * 4, [&] {
+		xivres::util::BlockDecompressImageBC7(Width, Height, blocks.data(), image.data());
+	});
+	runner.run("dxt/as_argb8888/DXT1", Width * Height, Width * Height * 4, [&] {
+		(void)xivres::texture::memory_mipmap_stream::as_argb8888(dxt1);
+	});
+	runner.run("dxt/as_argb8888/DXT3", Width * Height, Width * Height * 4, [&] {
+		(void)xivres::texture::memory_mipmap_stream::as_argb8888(dxt3);
+	});
+	runner.run("dxt/as_argb8888/DXT5", Width * Height, Width * Height * 4, [&] {
+		(void)xivres::texture::memory_mipmap_stream::as_argb8888(dxt5);
+	});
+	runner.run("dxt/as_argb8888/BC5", Width * Height, Width * Height * 4, [&] {
+		(void)xivres::texture::memory_mipmap_stream::as_argb8888(bc5);
+	});
+	runner.run("dxt/as_argb8888/BC7", Width * Height, Width * Height * 4, [&] {
+		(void)xivres::texture::memory_mipmap_stream::as_argb8888(bc7);
+	});
+}
+
+// Byte-at-a-time compression as hash_sha1 used to do it, kept to compare against.
+static void reference_sha1(const uint8_t* data, size_t length, uint8_t(&digest)[20]) {
+	uint32_t h[5]{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	uint8_t block[64];
+	size_t blockByteIndex = 0;
+	const auto rotl = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+	const auto process_block = [&] {
+		uint32_t w[80];
+		for (size_t i = 0; i < 16; i++)
+			w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+		for (size_t i = 16; i < 80; i++)
+			w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+		auto a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (size_t i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20)
+				f = (b & c) | (~b & d), k = 0x5A827999;
+			else if (i < 40)
+				f = b ^ c ^ d, k = 0x6ED9EBA1;
+			else if (i < 60)
+				f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+			else
+				f = b ^ c ^ d, k = 0xCA62C1D6;
+			const auto temp = rotl(a, 5) + f + e + k + w[i];
+			e = d, d = c, c = rotl(b, 30), b = a, a = temp;
+		}
+		h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+	};
+	const auto process_byte = [&](uint8_t octet) {
+		block[blockByteIndex++] = octet;
+		if (blockByteIndex == 64) {
+			blockByteIndex = 0;
+			process_block();
+		}
+	};
+
+	for (size_t i = 0; i < length; i++)
+		process_byte(data[i]);
+	const auto bitCount = static_cast<uint64_t>(length) * 8;
+	process_byte(0x80);
+	while (blockByteIndex != 56)
+		process_byte(0);
+	for (int i = 7; i >= 0; i--)
+		process_byte(static_cast<uint8_t>(bitCount >> (8 * i)));
+	for (size_t i = 0; i < 20; i++)
+		digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void bench_sha1(benchmark_runner& runner) {
+	static constexpr size_t Size = 64 * 1048576;
+
+	std::mt19937 rng(0x78697672);
+	std::vector<uint8_t> data(Size);
+	for (auto& b : data)
+		b = static_cast<uint8_t>(rng());
+
+	xivres::sha1_value expected, actual;
+	reference_sha1(data.data(), data.size(), expected.Value);
+	actual.set_from_ptr(data.data(), data.size());
+	if (expected != actual) {
+		std::cerr << "sha1: hash_sha1 does not match the reference implementation.\n";
+		return;
+	}
+
+	runner.run("sha1/reference", 1, Size, [&] {
+		reference_sha1(data.data(), data.size(), actual.Value);
+	});
+	runner.run("sha1/process_bytes", 1, Size, [&] {
+		actual.set_from_ptr(data.data(), data.size());
+	});
+	runner.run("sha1/process_bytes/4096", Size / 4096, Size, [&] {
+		xivres::util::hash_sha1 sha1;
+		for (size_t i = 0; i < Size; i += 4096)
+			sha1.process_bytes(&data[i], 4096);
+		sha1.get_digest_bytes(actual.Value);
+	});
+}
+
+static void bench_excel(benchmark_runner& runner, const xivres::installation& gameReader, std::span<const std::string> sheetNames) {
+	for (const auto& sheetName : sheetNames) {
+		size_t rowCount = 0;
+		try {
+			const auto sheet = gameReader.get_excel(sheetName);
+			for (size_t i = 0; i < sheet.get_exh_reader().get_pages().size(); i++)
+				rowCount += sheet.get_exd_reader(i).size();
+		} catch (const std::exception& e) {
+			std::cerr << std::format("excel/{}: skipped: {}\n", sheetName, e.what());
+			continue;
+		}
+
+		runner.run(std::format("excel/iterate_rows/{}", sheetName), rowCount, 0, [&gameReader, &sheetName] {
+			// A fresh reader every iteration, so that page loading and cell parsing are both measured.
+			const auto sheet = gameReader.get_excel(sheetName);
+			size_t cells = 0;
+			for (size_t i = 0; i < sheet.get_exh_reader().get_pages().size(); i++) {
+				for (const auto& row : sheet.get_exd_reader(i)) {
+					for (const auto& subrow : row) {
+						for (const auto& cell : subrow)
+							cells += cell.Type != xivres::excel::cell_type::String || !cell.String.empty() ? 1 : 0;
+					}
+				}
+			}
+			if (!cells)
+				throw std::runtime_error("No cell read");
+		});
+	}
+}
+
+int main(int argc, char** argv) {
+	std::filesystem::path gamePath;
+	std::filesystem::path outputPath;
+	std::chrono::milliseconds minDuration(1000);
+	uint64_t maxIterations = 1000000;
+	size_t samplesPerType = 16;
+	bool quick = false;
+
+	for (int i = 1; i < argc; i++) {
+		const auto arg = std::string_view(argv[i]);
+		if (arg == "--game" && i + 1 < argc)
+			gamePath = argv[++i];
+		else if (arg == "--output" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "--min-time-ms" && i + 1 < argc)
+			minDuration = std::chrono::milliseconds(std::stoll(argv[++i]));
+		else if (arg == "--max-iterations" && i + 1 < argc)
+			maxIterations = std::stoull(argv[++i]);
+		else if (arg == "--samples" && i + 1 < argc)
+			samplesPerType = std::stoull(argv[++i]);
+		else if (arg == "--quick")
+			quick = true;
+		else {
+			std::cerr << "Usage: benchmark [--game <path to game directory>] [--output <json path>] [--min-time-ms <n>] [--max-iterations <n>] [--samples <n>] [--quick]\n";
+			return 1;
+		}
+	}
+
+	if (quick) {
+		minDuration = std::chrono::milliseconds(100);
+		samplesPerType = (std::min<size_t>)(samplesPerType, 4);
+	}
+
+	if (gamePath.empty())
+		gamePath = xivres::installation::find_installation_global();
+
+	benchmark_runner runner(minDuration, maxIterations);
+
+	bench_dxt(runner);
+	bench_sha1(runner);
+	bench_thread_pool(runner);
+	bench_object_pool(runner);
+	bench_generator_entries(runner, 1000000);
+
+	if (!gamePath.empty() && exists(gamePath / "sqpack")) {
+		const auto gameReader = xivres::installation(gamePath);
+
+		static constexpr uint32_t ReaderPackIds[]{0x000000, 0x040000, 0x0a0000};
+		bench_reader(runner, gameReader, gamePath, ReaderPackIds);
+
+		const auto samples = collect_samples(gameReader, samplesPerType, 65536);
+		bench_unpack(runner, samples);
+		bench_pack(runner, samples);
+		bench_incompressible(runner, samples);
+		bench_export(runner, samples, std::filesystem::temp_directory_path() / "xivres.benchmark");
+
+		static const std::string ExcelSheets[]{"Action", "Addon", "Item"};
+		bench_excel(runner, gameReader, ExcelSheets);
+	} else {
+		std::cerr << "Game installation not found; only synthetic benchmarks were run.\n";
+	}
+
+	if (outputPath.empty()) {
+		runner.write_json(std::cout);
+	} else {
+		std::ofstream os(outputPath);
+		runner.write_json(os);
+	}
+	return 0;
+}
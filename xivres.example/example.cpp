@@ -16,6 +16,8 @@
 #include "xivres/texture.preview.h"
 #include "xivres/texture.stream.h"
 #include "xivres/unpacked_stream.h"
+#include "xivres/unpacked_stream.standard.h"
+#include "xivres/util.co_task.h"
 #include "xivres/util.thread_pool.h"
 #include "xivres/util.unicode.h"
 
@@ -190,9 +192,16 @@ static void test_sqpack_generator(const xivres::installation& gameReader) {
 				}
 				const auto dir = std::filesystem::path(std::format("C:/ffxiv/game/sqpack/{}", generator.DatExpac));
 				create_directories(dir);
-				const auto callbackHolder = generator.ProgressCallback([p](size_t progress, size_t progressMax) {
-					if (progress % 1000 == 0)
-						std::cout << std::format("Export: {:06x}: {}/{}", p, progress, progressMax) << std::endl;
+				generator.set_progress_interval(std::chrono::seconds(1));
+				const auto callbackHolder = generator.ExportProgressCallback([p](const xivres::sqpack::generator::export_progress& progress) {
+					std::cout << std::format("Export: {:06x}: scanned {}/{}, measured {}/{}, written {}/{}, {:.0f} entries/s, {:.1f} MiB/s, ~{}s left",
+						p,
+						progress.ScannedEntryCount, progress.EntryCount,
+						progress.MeasuredEntryCount, progress.StoredEntryCount,
+						progress.CompletedEntryCount, progress.StoredEntryCount,
+						progress.entries_per_second(),
+						progress.written_bytes_per_second() / 1048576,
+						std::chrono::duration_cast<std::chrono::seconds>(progress.estimated_remaining()).count()) << std::endl;
 				});
 				generator.export_to_files(dir);
 				std::cout << std::format("Complete: {:06x}", p) << std::endl;
@@ -509,6 +518,58 @@ static void test_size_reduction(const xivres::installation& gameReader) {
 	std::cout << std::endl;
 }
 
+static xivres::util::thread_pool::co_task<size_t> read_all_async(std::vector<std::unique_ptr<xivres::standard_unpacker>>& unpackers) {
+	std::vector<xivres::util::thread_pool::co_task<std::streamsize>> reads;
+	std::vector<std::vector<uint8_t>> buffers(unpackers.size());
+	for (size_t i = 0; i < unpackers.size(); i++) {
+		buffers[i].resize(unpackers[i]->size());
+		reads.emplace_back(unpackers[i]->read_async(0, buffers[i].data(), unpackers[i]->size()));
+	}
+
+	size_t total = 0;
+	for (const auto read : co_await xivres::util::thread_pool::when_all(std::move(reads)))
+		total += static_cast<size_t>(read);
+	co_return total;
+}
+
+static void test_coroutine_read(const xivres::installation& gameReader) {
+	const auto& packfile = gameReader.get_sqpack(0x0a0000);
+	std::vector<std::unique_ptr<xivres::standard_unpacker>> unpackers;
+	for (const auto& entry : packfile.Entries) {
+		auto unpacker = xivres::base_unpacker::make_unique(packfile.packed_at(entry));
+		if (const auto pStandard = dynamic_cast<xivres::standard_unpacker*>(unpacker.get())) {
+			unpacker.release();
+			unpackers.emplace_back(pStandard);
+		}
+	}
+
+	auto& pool = xivres::util::thread_pool::pool::instance();
+	pool.collect_statistics(true);
+
+	pool.reset_statistics();
+	xivres::util::thread_pool::task_waiter<std::streamsize> waiter;
+	for (auto& unpacker : unpackers) {
+		waiter.submit([&unpacker](auto&) {
+			std::vector<uint8_t> buffer(unpacker->size());
+			return unpacker->read(0, buffer.data(), unpacker->size());
+		});
+	}
+	size_t syncTotal = 0;
+	while (const auto r = waiter.get())
+		syncTotal += static_cast<size_t>(*r);
+	const auto syncStats = pool.statistics();
+
+	pool.reset_statistics();
+	const auto asyncTotal = read_all_async(unpackers).get();
+	const auto asyncStats = pool.statistics();
+
+	std::cout << std::format("Synchronous: {} files, {} bytes, {}ms, peak {} threads ({} waiting)\n",
+		unpackers.size(), syncTotal, std::chrono::duration_cast<std::chrono::milliseconds>(syncStats.Elapsed).count(), syncStats.PeakThreadCount, syncStats.PeakWaitingThreadCount);
+	std::cout << std::format("Coroutine: {} files, {} bytes, {}ms, peak {} threads ({} waiting)\n",
+		unpackers.size(), asyncTotal, std::chrono::duration_cast<std::chrono::milliseconds>(asyncStats.Elapsed).count(), asyncStats.PeakThreadCount, asyncStats.PeakWaitingThreadCount);
+	pool.collect_statistics(false);
+}
+
 int main() {
 	const auto tend = GetTickCount64();
 	SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
@@ -560,6 +621,7 @@ int main() {
 	// test_sqpack_generator(gameReader);
 	// test_ogg_decode_encode(gameReader);
 	// test_excel(gameReader);
+	// test_coroutine_read(gameReader);
 
 	std::cout << "Success: took " << (GetTickCount64() - tend) << "ms" << std::endl;
 	return 0;
@@ -277,70 +277,61 @@ void xivres::fontgen::fontdata_packer::draw_layoutted_glyphs(util::thread_pool::
 }
 
 void xivres::fontgen::fontdata_packer::measure_glyphs() {
-	util::thread_pool::task_waiter waiter;
-
-	const auto divideUnit = (std::max<size_t>)(1, static_cast<size_t>(std::sqrt(static_cast<double>(m_targetPlans.size()))));
-	for (size_t nBase = 0; nBase < divideUnit; nBase++) {
-		waiter.submit([this, divideUnit, nBase](auto& task) {
-			for (size_t i = nBase; i < m_targetPlans.size() && !m_bCancelRequested; i += divideUnit) {
-				++m_nCurrentProgress;
-				task.throw_if_cancelled();
-
-				auto& info = m_targetPlans[i];
-
-				auto pooledBaseFont = *m_threadSafeBaseFonts[info.BaseFont];
-				if (!pooledBaseFont)
-					pooledBaseFont.emplace(m_baseFonts[info.BaseFont]->get_threadsafe_view());
-				const auto& baseFont = **pooledBaseFont;
-
-				glyph_metrics gm;
-				if (!baseFont.try_get_glyph_metrics(info.Codepoint, gm))
-					throw std::runtime_error("Base font reported to have a codepoint but it's failing to report glyph metrics");
-
-				info.CurrentOffsetX = util::range_check_cast<int16_t>((std::min<int>)(0, gm.X1));
-				info.BaseEntry.BoundingWidth = util::range_check_cast<uint8_t>(gm.X2 - info.CurrentOffsetX);
-
-				info.PadUp = info.PadDown = 0;
-				info.BaseEntry.CurrentOffsetY = util::range_check_cast<int8_t>(gm.Y1);
-				info.BaseEntry.BoundingHeight = util::range_check_cast<uint8_t>(gm.height());
-
-				for (auto& target : info.Targets) {
-					auto pooledSourceFont = **m_threadSafeSourceFonts[target.SourceFontIndex];
-					if (!pooledSourceFont)
-						pooledSourceFont.emplace(m_sourceFonts[target.SourceFontIndex]->get_threadsafe_view());
-
-					auto& sourceFont = **pooledSourceFont;
-
-					if (!sourceFont.try_get_glyph_metrics(info.Codepoint, gm))
-						throw std::runtime_error("Font reported to have a codepoint but it's failing to report glyph metrics");
-					if (gm.X1 < 0)
-						throw std::runtime_error("Glyphs for target fonts cannot have negative LSB");
-					if (gm.height() != *info.BaseEntry.BoundingHeight)
-						throw std::runtime_error("Target font has a glyph with different bounding height from the source");
-
-					if (gm.Y1 > 0)
-						target.Entry.TextureOffsetY = util::range_check_cast<uint16_t>(gm.Y1);
-					else
-						target.Entry.CurrentOffsetY = util::range_check_cast<int8_t>(gm.Y1);
-					target.Entry.BoundingHeight = util::range_check_cast<uint8_t>((std::max<uint32_t>)(gm.Y2, target.Font.line_height()) - (std::min)(0, gm.Y1));
-					target.Entry.BoundingWidth = util::range_check_cast<uint8_t>(gm.X2 - (std::min)(0, gm.X1));
-					target.Entry.NextOffsetX = util::range_check_cast<int8_t>(gm.AdvanceX - target.Entry.BoundingWidth);
-
-					if (*info.BaseEntry.BoundingWidth < *target.Entry.BoundingWidth) {
-						info.CurrentOffsetX = util::range_check_cast<int16_t>(info.CurrentOffsetX - *target.Entry.BoundingWidth + *info.BaseEntry.BoundingWidth);
-						info.BaseEntry.BoundingWidth = *target.Entry.BoundingWidth;
-					}
-
-					if (gm.Y1 > info.PadUp)
-						info.PadUp = util::range_check_cast<int8_t>(gm.Y1);
-					if (info.PadDown + info.PadUp + *info.BaseEntry.BoundingHeight < target.Entry.BoundingHeight)
-						info.PadDown = util::range_check_cast<int8_t>(target.Entry.BoundingHeight - info.PadUp - *info.BaseEntry.BoundingHeight);
-				}
+	util::thread_pool::parallel_for(m_targetPlans, 0, [this](target_plan& info) {
+		if (m_bCancelRequested)
+			return;
+
+		++m_nCurrentProgress;
+
+		auto pooledBaseFont = *m_threadSafeBaseFonts[info.BaseFont];
+		if (!pooledBaseFont)
+			pooledBaseFont.emplace(m_baseFonts[info.BaseFont]->get_threadsafe_view());
+		const auto& baseFont = **pooledBaseFont;
+
+		glyph_metrics gm;
+		if (!baseFont.try_get_glyph_metrics(info.Codepoint, gm))
+			throw std::runtime_error("Base font reported to have a codepoint but it's failing to report glyph metrics");
+
+		info.CurrentOffsetX = util::range_check_cast<int16_t>((std::min<int>)(0, gm.X1));
+		info.BaseEntry.BoundingWidth = util::range_check_cast<uint8_t>(gm.X2 - info.CurrentOffsetX);
+
+		info.PadUp = info.PadDown = 0;
+		info.BaseEntry.CurrentOffsetY = util::range_check_cast<int8_t>(gm.Y1);
+		info.BaseEntry.BoundingHeight = util::range_check_cast<uint8_t>(gm.height());
+
+		for (auto& target : info.Targets) {
+			auto pooledSourceFont = **m_threadSafeSourceFonts[target.SourceFontIndex];
+			if (!pooledSourceFont)
+				pooledSourceFont.emplace(m_sourceFonts[target.SourceFontIndex]->get_threadsafe_view());
+
+			auto& sourceFont = **pooledSourceFont;
+
+			if (!sourceFont.try_get_glyph_metrics(info.Codepoint, gm))
+				throw std::runtime_error("Font reported to have a codepoint but it's failing to report glyph metrics");
+			if (gm.X1 < 0)
+				throw std::runtime_error("Glyphs for target fonts cannot have negative LSB");
+			if (gm.height() != *info.BaseEntry.BoundingHeight)
+				throw std::runtime_error("Target font has a glyph with different bounding height from the source");
+
+			if (gm.Y1 > 0)
+				target.Entry.TextureOffsetY = util::range_check_cast<uint16_t>(gm.Y1);
+			else
+				target.Entry.CurrentOffsetY = util::range_check_cast<int8_t>(gm.Y1);
+			target.Entry.BoundingHeight = util::range_check_cast<uint8_t>((std::max<uint32_t>)(gm.Y2, target.Font.line_height()) - (std::min)(0, gm.Y1));
+			target.Entry.BoundingWidth = util::range_check_cast<uint8_t>(gm.X2 - (std::min)(0, gm.X1));
+			target.Entry.NextOffsetX = util::range_check_cast<int8_t>(gm.AdvanceX - target.Entry.BoundingWidth);
+
+			if (*info.BaseEntry.BoundingWidth < *target.Entry.BoundingWidth) {
+				info.CurrentOffsetX = util::range_check_cast<int16_t>(info.CurrentOffsetX - *target.Entry.BoundingWidth + *info.BaseEntry.BoundingWidth);
+				info.BaseEntry.BoundingWidth = *target.Entry.BoundingWidth;
 			}
-		});
-	}
 
-	waiter.wait_all();
+			if (gm.Y1 > info.PadUp)
+				info.PadUp = util::range_check_cast<int8_t>(gm.Y1);
+			if (info.PadDown + info.PadUp + *info.BaseEntry.BoundingHeight < target.Entry.BoundingHeight)
+				info.PadDown = util::range_check_cast<int8_t>(target.Entry.BoundingHeight - info.PadUp - *info.BaseEntry.BoundingHeight);
+		}
+	});
 }
 
 void xivres::fontgen::fontdata_packer::prepare_target_codepoints() {
@@ -0,0 +1,214 @@
+#include "../include/xivres/packed_stream.cache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+#include "../include/xivres/packed_stream.h"
+
+namespace {
+	std::mutex s_instanceMtx;
+	std::shared_ptr<xivres::packed_stream_cache> s_instance;
+
+	constexpr auto FileExtension = ".packed";
+}
+
+xivres::packed_stream_cache::key xivres::packed_stream_cache::key::of(const stream& unpacked, packed::type type, int compressionLevel) {
+	key res{
+		.Type = type,
+		.CompressionLevel = compressionLevel,
+		.EntropyThreshold = compressing_packer::incompressible_entropy_threshold(),
+	};
+
+	util::hash_sha1 sha1;
+	std::vector<uint8_t> buf(1048576);
+	const auto size = static_cast<uint64_t>(unpacked.size());
+	align<uint64_t>(size, buf.size()).iterate_chunks([&](uint64_t, uint64_t offset, uint64_t length) {
+		unpacked.read_fully(static_cast<std::streamoff>(offset), &buf[0], static_cast<std::streamsize>(length));
+		sha1.process_bytes(&buf[0], static_cast<size_t>(length));
+	});
+	sha1.get_digest_bytes(res.ContentSha1.Value);
+	return res;
+}
+
+std::string xivres::packed_stream_cache::key::file_name() const {
+	std::string res;
+	res.reserve(80);
+	for (const auto b : ContentSha1.Value)
+		res += std::format("{:02x}", b);
+	res += std::format(".{}.{}.{}.{}{}", static_cast<uint32_t>(Type), CompressionLevel, PackerVersion, static_cast<int>(EntropyThreshold * 1000), FileExtension);
+	return res;
+}
+
+xivres::packed_stream_cache::packed_stream_cache(std::filesystem::path dir, uint64_t maxBytes)
+	: m_dir(std::move(dir))
+	, m_maxBytes(maxBytes) {
+	std::filesystem::create_directories(m_dir);
+
+	// Files written earlier count as used in the order of their modification time.
+	std::vector<std::tuple<std::filesystem::file_time_type, std::string, uint64_t>> existing;
+	for (const auto& item : std::filesystem::directory_iterator(m_dir)) {
+		if (!item.is_regular_file() || item.path().extension() != FileExtension)
+			continue;
+
+		std::error_code ec;
+		const auto size = item.file_size(ec);
+		const auto time = item.last_write_time(ec);
+		if (!ec)
+			existing.emplace_back(time, item.path().filename().string(), size);
+	}
+	std::ranges::sort(existing);
+
+	for (auto& [time, name, size] : existing) {
+		m_entries.emplace(std::move(name), entry_info{.Size = size, .LastUse = ++m_useCounter});
+		m_totalBytes += size;
+	}
+
+	if (m_totalBytes > m_maxBytes)
+		evict(m_maxBytes);
+}
+
+std::unique_ptr<xivres::stream> xivres::packed_stream_cache::find(const key& k) {
+	const auto name = k.file_name();
+	const auto path = m_dir / name;
+
+	// Another process sharing the directory may have stored or evicted it, so the file decides whether it is a hit.
+	std::vector<uint8_t> data;
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (in) {
+			in.seekg(0, std::ios::end);
+			if (const auto size = static_cast<std::streamoff>(in.tellg()); size > 0) {
+				data.resize(static_cast<size_t>(size));
+				in.seekg(0, std::ios::beg);
+				in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+			}
+		}
+
+		if (!in || data.empty()) {
+			++m_missCount;
+			const auto lock = std::lock_guard(m_mtx);
+			if (const auto it = m_entries.find(name); it != m_entries.end()) {
+				m_totalBytes -= it->second.Size;
+				m_entries.erase(it);
+			}
+			return nullptr;
+		}
+	}
+
+	{
+		const auto lock = std::lock_guard(m_mtx);
+		auto& entry = m_entries[name];
+		if (entry.Size != data.size()) {
+			m_totalBytes += data.size() - entry.Size;
+			entry.Size = data.size();
+		}
+		entry.LastUse = ++m_useCounter;
+	}
+
+	// Keep the recency for the next run too.
+	std::error_code ec;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+	++m_hitCount;
+	m_hitBytes += data.size();
+	return std::make_unique<memory_stream>(std::move(data));
+}
+
+void xivres::packed_stream_cache::store(const key& k, const stream& packed) {
+	const auto size = static_cast<uint64_t>(packed.size());
+	if (!size || size > m_maxBytes)
+		return;
+
+	const auto name = k.file_name();
+	const auto path = m_dir / name;
+	auto tempPath = path;
+	tempPath += std::format(".{:x}{:x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()), std::chrono::steady_clock::now().time_since_epoch().count());
+
+	// Failing to store is not an error for the caller; the data just gets packed again next time.
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return;
+
+		std::vector<uint8_t> buf(65536);
+		align<uint64_t>(size, buf.size()).iterate_chunks([&](uint64_t, uint64_t offset, uint64_t length) {
+			packed.read_fully(static_cast<std::streamoff>(offset), &buf[0], static_cast<std::streamsize>(length));
+			out.write(reinterpret_cast<const char*>(&buf[0]), static_cast<std::streamsize>(length));
+		});
+
+		if (!out) {
+			out.close();
+			std::error_code ec;
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	// Renaming makes the file appear complete or not at all to whoever reads it.
+	std::error_code ec;
+	std::filesystem::rename(tempPath, path, ec);
+	if (ec) {
+		std::filesystem::remove(tempPath, ec);
+		return;
+	}
+
+	++m_storedCount;
+	m_storedBytes += size;
+
+	const auto lock = std::lock_guard(m_mtx);
+	auto& entry = m_entries[name];
+	m_totalBytes += size - entry.Size;
+	entry.Size = size;
+	entry.LastUse = ++m_useCounter;
+
+	if (m_totalBytes > m_maxBytes)
+		evict(m_maxBytes);
+}
+
+uint64_t xivres::packed_stream_cache::size() const {
+	const auto lock = std::lock_guard(m_mtx);
+	return m_totalBytes;
+}
+
+xivres::packed_stream_cache::stats xivres::packed_stream_cache::statistics() const {
+	return {
+		.HitCount = m_hitCount,
+		.MissCount = m_missCount,
+		.StoredCount = m_storedCount,
+		.EvictedCount = m_evictedCount,
+		.HitBytes = m_hitBytes,
+		.StoredBytes = m_storedBytes,
+		.EvictedBytes = m_evictedBytes,
+	};
+}
+
+void xivres::packed_stream_cache::instance(std::shared_ptr<packed_stream_cache> cache) {
+	const auto lock = std::lock_guard(s_instanceMtx);
+	s_instance = std::move(cache);
+}
+
+std::shared_ptr<xivres::packed_stream_cache> xivres::packed_stream_cache::instance() {
+	const auto lock = std::lock_guard(s_instanceMtx);
+	return s_instance;
+}
+
+void xivres::packed_stream_cache::evict(uint64_t targetBytes) {
+	std::vector<std::map<std::string, entry_info>::iterator> order;
+	order.reserve(m_entries.size());
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		order.emplace_back(it);
+	std::ranges::sort(order, [](const auto& l, const auto& r) { return l->second.LastUse < r->second.LastUse; });
+
+	for (const auto& it : order) {
+		if (m_totalBytes <= targetBytes)
+			break;
+
+		std::error_code ec;
+		std::filesystem::remove(m_dir / it->first, ec);
+		++m_evictedCount;
+		m_evictedBytes += it->second.Size;
+		m_totalBytes -= it->second.Size;
+		m_entries.erase(it);
+	}
+}
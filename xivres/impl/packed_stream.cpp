@@ -1,4 +1,9 @@
 #include "../include/xivres/packed_stream.h"
+
+#include <array>
+#include <cmath>
+#include <fstream>
+
 #include "../include/xivres/unpacked_stream.h"
 
 xivres::unpacked_stream xivres::packed_stream::get_unpacked(std::span<uint8_t> obfuscatedHeaderRewrite) const {
@@ -13,6 +18,118 @@ void xivres::compressing_packer::preload() {
 	m_preloadedStream.emplace(m_stream);
 }
 
+namespace {
+	// One in this many blocks found incompressible gets deflated anyway, to keep track of what skipping them costs.
+	constexpr uint64_t IncompressibleSampleInterval = 64;
+
+	std::atomic<double> s_incompressibleEntropyThreshold = 7.95;
+
+	struct {
+		std::atomic_uint64_t ProbedBlockCount;
+		std::atomic_uint64_t SkippedBlockCount;
+		std::atomic_uint64_t SkippedBytes;
+		std::atomic_uint64_t SampledBlockCount;
+		std::atomic_uint64_t SampledBytes;
+		std::atomic_uint64_t SampledDeflatedBytes;
+		std::atomic_int64_t SampledDeflateTimeNs;
+	} s_incompressibleStats;
+
+	// Order-0 entropy in bits per byte; already compressed data comes close to 8.
+	double entropy_of(std::span<const uint8_t> data) {
+		if (data.empty())
+			return 0;
+
+		// Interleaved counters avoid stalls from consecutive increments of the same counter.
+		std::array<std::array<uint32_t, 256>, 4> counts{};
+		size_t i = 0;
+		for (; i + 4 <= data.size(); i += 4) {
+			++counts[0][data[i]];
+			++counts[1][data[i + 1]];
+			++counts[2][data[i + 2]];
+			++counts[3][data[i + 3]];
+		}
+		for (; i < data.size(); ++i)
+			++counts[0][data[i]];
+
+		double sum = 0;
+		for (size_t b = 0; b < 256; ++b) {
+			if (const auto c = counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b])
+				sum += c * std::log2(static_cast<double>(c));
+		}
+		const auto n = static_cast<double>(data.size());
+		return std::log2(n) - sum / n;
+	}
+}
+
+std::chrono::nanoseconds xivres::compressing_packer::incompressible_stats::estimated_time_saved() const {
+	if (!SampledBytes)
+		return {};
+	return std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(SampledDeflateTime.count()) * static_cast<double>(SkippedBytes - SampledBytes) / static_cast<double>(SampledBytes)));
+}
+
+uint64_t xivres::compressing_packer::incompressible_stats::estimated_bytes_lost() const {
+	if (!SampledBytes || SampledDeflatedBytes >= SampledBytes)
+		return 0;
+	return static_cast<uint64_t>(static_cast<double>(SampledBytes - SampledDeflatedBytes) * static_cast<double>(SkippedBytes - SampledBytes) / static_cast<double>(SampledBytes));
+}
+
+void xivres::compressing_packer::incompressible_entropy_threshold(double bitsPerByte) {
+	s_incompressibleEntropyThreshold = bitsPerByte;
+}
+
+double xivres::compressing_packer::incompressible_entropy_threshold() {
+	return s_incompressibleEntropyThreshold;
+}
+
+xivres::compressing_packer::incompressible_stats xivres::compressing_packer::incompressible_statistics() {
+	return {
+		.ProbedBlockCount = s_incompressibleStats.ProbedBlockCount,
+		.SkippedBlockCount = s_incompressibleStats.SkippedBlockCount,
+		.SkippedBytes = s_incompressibleStats.SkippedBytes,
+		.SampledBlockCount = s_incompressibleStats.SampledBlockCount,
+		.SampledBytes = s_incompressibleStats.SampledBytes,
+		.SampledDeflatedBytes = s_incompressibleStats.SampledDeflatedBytes,
+		.SampledDeflateTime = std::chrono::nanoseconds(s_incompressibleStats.SampledDeflateTimeNs),
+	};
+}
+
+void xivres::compressing_packer::reset_incompressible_statistics() {
+	s_incompressibleStats.ProbedBlockCount = 0;
+	s_incompressibleStats.SkippedBlockCount = 0;
+	s_incompressibleStats.SkippedBytes = 0;
+	s_incompressibleStats.SampledBlockCount = 0;
+	s_incompressibleStats.SampledBytes = 0;
+	s_incompressibleStats.SampledDeflatedBytes = 0;
+	s_incompressibleStats.SampledDeflateTimeNs = 0;
+}
+
+std::optional<uint64_t> xivres::compressing_packer::pack_to(const output_fn& output) {
+	const auto packed = pack();
+	if (!packed)
+		return std::nullopt;
+
+	std::vector<uint8_t> buf(65536);
+	const auto size = static_cast<uint64_t>(packed->size());
+	align<uint64_t>(size, buf.size()).iterate_chunks([&](uint64_t, uint64_t offset, uint64_t length) {
+		packed->read_fully(static_cast<std::streamoff>(offset), &buf[0], static_cast<std::streamsize>(length));
+		output(offset, std::span(buf).subspan(0, static_cast<size_t>(length)));
+	});
+	return size;
+}
+
+std::optional<uint64_t> xivres::compressing_packer::pack_to(const std::filesystem::path& path) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error("Failed to open output file.");
+
+	return pack_to([&out](uint64_t offset, std::span<const uint8_t> data) {
+		out.seekp(static_cast<std::streamoff>(offset), std::ios::beg);
+		out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!out)
+			throw std::runtime_error("Failed to write to output file.");
+	});
+}
+
 void xivres::compressing_packer::compress_block(uint32_t offset, uint32_t length, block_data_t& blockData) const {
 	if (cancelled())
 		return;
@@ -27,12 +144,43 @@ void xivres::compressing_packer::compress_block(uint32_t offset, uint32_t length
 	if (const auto read = static_cast<size_t>(unpacked().read(offset, &buffer[0], length)); read != length)
 		std::fill_n(&buffer[read], length - read, 0);
 
-	blockData.DecompressedSize = static_cast<uint32_t>(length);
+	compress_block(std::move(buffer), blockData);
+}
+
+void xivres::compressing_packer::compress_block(std::vector<uint8_t> buffer, block_data_t& blockData) const {
+	blockData.DecompressedSize = static_cast<uint32_t>(buffer.size());
 	if (compression_level()) {
+		auto sampled = false;
+		if (const auto threshold = s_incompressibleEntropyThreshold.load(); threshold < 8) {
+			++s_incompressibleStats.ProbedBlockCount;
+			if (entropy_of(buffer) >= threshold) {
+				s_incompressibleStats.SkippedBytes += buffer.size();
+				if (++s_incompressibleStats.SkippedBlockCount % IncompressibleSampleInterval != 0) {
+					blockData.Data = std::move(buffer);
+					return;
+				}
+				sampled = true;
+			}
+		}
+
+		const auto deflateStart = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
 		auto deflater = util::zlib_deflater::pooled();
 		if (!deflater || !deflater->is(compression_level(), Z_DEFLATED, -15))
 			deflater.emplace(compression_level(), Z_DEFLATED, -15);
-		if (deflater->deflate(std::span(buffer)).size() < buffer.size()) {
+		const auto deflatedSize = deflater->deflate(std::span(buffer)).size();
+
+		if (sampled) {
+			++s_incompressibleStats.SampledBlockCount;
+			s_incompressibleStats.SampledBytes += buffer.size();
+			s_incompressibleStats.SampledDeflatedBytes += (std::min)(deflatedSize, buffer.size());
+			s_incompressibleStats.SampledDeflateTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - deflateStart).count();
+
+			// Which blocks get sampled depends on the timing of other threads, so the result must not depend on it.
+			blockData.Data = std::move(buffer);
+			return;
+		}
+
+		if (deflatedSize < buffer.size()) {
 			blockData.Data = std::move(deflater->result());
 			blockData.Deflated = true;
 			return;
@@ -22,7 +22,7 @@ void xivres::model_passthrough_packer::ensure_initialized() {
 		return;
 
 	{
-		const auto _ = util::thread_pool::pool::instance().release_working_status();
+		const auto _ = util::thread_pool::pool::current().release_working_status();
 		lock.lock();
 	}
 	if (*m_header.Entry.DecompressedSize)
@@ -1,5 +1,6 @@
 #include "../include/xivres/packed_stream.standard.h"
 
+#include <map>
 #include <ranges>
 
 #include "../include/xivres/util.thread_pool.h"
@@ -117,81 +118,117 @@ std::streamsize xivres::standard_passthrough_packer::translate_read(std::streamo
 }
 
 std::unique_ptr<xivres::stream> xivres::standard_compressing_packer::pack() {
-	const auto rawStreamSize = static_cast<uint32_t>(unpacked().size());
+	std::vector<uint8_t> result;
+	const auto packedSize = pack_to([&result](uint64_t offset, std::span<const uint8_t> data) {
+		if (result.size() < offset + data.size())
+			result.resize(static_cast<size_t>(offset + data.size()));
+		std::ranges::copy(data, result.begin() + static_cast<ptrdiff_t>(offset));
+	});
+	if (!packedSize)
+		return nullptr;
 
-	const auto blockAlignment = align<uint32_t>(rawStreamSize, packed::MaxBlockDataSize);
-	std::vector<block_data_t> blockDataList(blockAlignment.Count);
+	return std::make_unique<memory_stream>(std::move(result));
+}
 
-	if (!multithreaded()) {
-		blockAlignment.iterate_chunks_breakable([&](const uint32_t index, const uint32_t offset, const uint32_t length) {
-			compress_block(offset, length, blockDataList[index]);
-			return !cancelled();
-		});
-		
-	} else {
-		util::thread_pool::task_waiter waiter;
-		preload();
-
-		blockAlignment.iterate_chunks_breakable([&](const uint32_t index, const uint32_t offset, const uint32_t length) {
-			waiter.submit([this, offset, length, &blockData = blockDataList[index]](auto& task) {
-				if (task.cancelled())
-					cancel();
-				if (!cancelled())
-					compress_block(offset, length, blockData);
-			});
-
-			return !cancelled();
-		});
-
-		if (!cancelled())
-			waiter.wait_all();
-	}
+std::optional<uint64_t> xivres::standard_compressing_packer::pack_to(const output_fn& output) {
+	// Number of blocks read from the source at once.
+	static constexpr uint32_t WindowBlockCount = 64;
 
-	if (cancelled())
-		return nullptr;
+	const auto rawStreamSize = static_cast<uint32_t>(unpacked().size());
+	const auto blockAlignment = align<uint32_t>(rawStreamSize, packed::MaxBlockDataSize);
 
-	const auto entryHeaderLength = static_cast<uint16_t>(align(0
+	const auto entryHeaderLength = static_cast<uint32_t>(align(0
 		+ sizeof(packed::file_header)
 		+ sizeof(packed::standard_block_locator) * blockAlignment.Count
 	));
-	size_t entryBodyLength = 0;
-	for (const auto& blockData : blockDataList)
-		entryBodyLength += align(sizeof(packed::block_header) + blockData.Data.size());
-
-	std::vector<uint8_t> result(entryHeaderLength + entryBodyLength);
-
-	auto& entryHeader = *reinterpret_cast<packed::file_header*>(&result[0]);
-	entryHeader.Type = packed::type::standard;
-	entryHeader.DecompressedSize = rawStreamSize;
-	entryHeader.BlockCountOrVersion = static_cast<uint32_t>(blockAlignment.Count);
-	entryHeader.HeaderSize = entryHeaderLength;
-	entryHeader.set_space_units(entryBodyLength);
-
-	const auto locators = util::span_cast<packed::standard_block_locator>(result, sizeof entryHeader, blockAlignment.Count);
-	auto resultDataPtr = result.begin() + entryHeaderLength;
-
-	blockAlignment.iterate_chunks_breakable([&](const uint32_t index, const uint32_t offset, const uint32_t length) {
-		if (cancelled())
-			return false;
-		auto& blockData = blockDataList[index];
-
-		auto& header = *reinterpret_cast<packed::block_header*>(&*resultDataPtr);
+	std::vector<uint8_t> entryHeaderData(entryHeaderLength);
+	const auto locators = util::span_cast<packed::standard_block_locator>(entryHeaderData, sizeof(packed::file_header), blockAlignment.Count);
+
+	// Blocks are emitted in order, as soon as all the blocks before them are done.
+	uint64_t entryBodyLength = 0;
+	std::vector<uint8_t> blockBuffer;
+	const auto emit_block = [&](uint32_t index, const block_data_t& blockData) {
+		const auto blockSize = align(sizeof(packed::block_header) + blockData.Data.size());
+		blockBuffer.clear();
+		blockBuffer.resize(blockSize.Alloc);
+
+		auto& header = *reinterpret_cast<packed::block_header*>(&blockBuffer[0]);
 		header.HeaderSize = sizeof(packed::block_header);
 		header.Version = 0;
 		header.CompressedSize = blockData.Deflated ? static_cast<uint32_t>(blockData.Data.size()) : packed::block_header::CompressedSizeNotCompressed;
-		header.DecompressedSize = length;
+		header.DecompressedSize = blockData.DecompressedSize;
+		std::ranges::copy(blockData.Data, blockBuffer.begin() + sizeof header);
 
-		std::ranges::copy(blockData.Data, resultDataPtr + sizeof header);
+		locators[index].Offset = static_cast<uint32_t>(entryBodyLength);
+		locators[index].BlockSize = static_cast<uint16_t>(blockSize.Alloc);
+		locators[index].DecompressedDataSize = static_cast<uint16_t>(blockData.DecompressedSize);
 
-		locators[index].Offset = index == 0 ? 0 : locators[index - 1].BlockSize + locators[index - 1].Offset;
-		locators[index].BlockSize = static_cast<uint16_t>(align(sizeof header + blockData.Data.size()));
-		locators[index].DecompressedDataSize = static_cast<uint16_t>(length);
+		output(entryHeaderLength + entryBodyLength, blockBuffer);
+		entryBodyLength += blockSize.Alloc;
+	};
 
-		resultDataPtr += locators[index].BlockSize;
+	std::vector<uint8_t> window;
+	uint32_t windowIndex = UINT32_MAX;
+	const auto read_block = [&](uint32_t index) {
+		if (index / WindowBlockCount != windowIndex) {
+			windowIndex = index / WindowBlockCount;
+			const auto windowOffset = static_cast<uint64_t>(windowIndex) * WindowBlockCount * packed::MaxBlockDataSize;
+			window.resize(static_cast<size_t>((std::min<uint64_t>)(rawStreamSize - windowOffset, WindowBlockCount * packed::MaxBlockDataSize)));
+			if (const auto read = static_cast<size_t>(unpacked().read(static_cast<std::streamoff>(windowOffset), &window[0], static_cast<std::streamsize>(window.size()))); read != window.size())
+				std::fill_n(&window[read], window.size() - read, 0);
+		}
+
+		const auto offset = static_cast<size_t>(index % WindowBlockCount) * packed::MaxBlockDataSize;
+		const auto length = (std::min<size_t>)(window.size() - offset, packed::MaxBlockDataSize);
+		return std::vector(window.begin() + static_cast<ptrdiff_t>(offset), window.begin() + static_cast<ptrdiff_t>(offset + length));
+	};
 
-		std::vector<uint8_t>().swap(blockData.Data);
-		return true;
-	});
+	if (!multithreaded()) {
+		for (uint32_t i = 0; i < blockAlignment.Count && !cancelled(); ++i) {
+			block_data_t blockData;
+			compress_block(read_block(i), blockData);
+			emit_block(i, blockData);
+		}
 
-	return std::make_unique<memory_stream>(std::move(result));
+	} else {
+		util::thread_pool::task_waiter<std::pair<uint32_t, block_data_t>> waiter;
+		const auto maxInFlight = (std::max<size_t>)(8, 2 * waiter.pool().concurrency());
+
+		// Includes the blocks that are done but waiting for an earlier block, so that a slow block cannot make the queue grow without bound.
+		std::map<uint32_t, block_data_t> completed;
+		for (uint32_t nextSubmit = 0, nextEmit = 0; nextEmit < blockAlignment.Count && !cancelled();) {
+			for (; nextSubmit < blockAlignment.Count && waiter.pending() + completed.size() < maxInFlight; ++nextSubmit) {
+				waiter.submit([this, index = nextSubmit, buffer = read_block(nextSubmit)](util::thread_pool::base_task& task) mutable {
+					if (task.cancelled())
+						cancel();
+
+					std::pair<uint32_t, block_data_t> res{index, {}};
+					if (!cancelled())
+						compress_block(std::move(buffer), res.second);
+					return res;
+				});
+			}
+
+			auto result = waiter.get();
+			if (!result)
+				break;
+			completed.emplace(result->first, std::move(result->second));
+
+			for (auto it = completed.begin(); it != completed.end() && it->first == nextEmit && !cancelled(); it = completed.erase(it), ++nextEmit)
+				emit_block(nextEmit, it->second);
+		}
+	}
+
+	if (cancelled())
+		return std::nullopt;
+
+	auto& entryHeader = *reinterpret_cast<packed::file_header*>(&entryHeaderData[0]);
+	entryHeader.Type = packed::type::standard;
+	entryHeader.DecompressedSize = rawStreamSize;
+	entryHeader.BlockCountOrVersion = static_cast<uint32_t>(blockAlignment.Count);
+	entryHeader.HeaderSize = entryHeaderLength;
+	entryHeader.set_space_units(entryBodyLength);
+	output(0, entryHeaderData);
+
+	return entryHeaderLength + entryBodyLength;
 }
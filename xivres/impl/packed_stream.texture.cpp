@@ -303,42 +303,37 @@ std::unique_ptr<xivres::stream> xivres::texture_compressing_packer::pack() {
 		}
 
 	} else {
-		util::thread_pool::task_waiter waiter;
 		preload();
 
-		for (size_t mipmapIndex = 0; mipmapIndex < mipmapOffsets.size(); ++mipmapIndex) {
-			if (cancelled())
-				return nullptr;
+		struct block_job {
+			uint32_t Offset;
+			uint32_t Length;
+			block_data_t* Target;
+		};
+		std::vector<block_job> jobs;
 
+		for (size_t mipmapIndex = 0; mipmapIndex < mipmapOffsets.size(); ++mipmapIndex) {
 			const auto mipmapSize = mipmapSizes[mipmapIndex];
 			const auto mipmapOffset = mipmapOffsets[mipmapIndex];
 			blockDataList[mipmapIndex].resize(repeatCount);
 
 			for (uint32_t repeatIndex = 0; repeatIndex < repeatCount; repeatIndex++) {
-				if (cancelled())
-					return nullptr;
-
 				const auto repeatedUnitOffset = mipmapOffset + mipmapSize * repeatIndex;
 
 				const auto blockAlignment = align<uint32_t>(mipmapSize, packed::MaxBlockDataSize);
 				auto& blockDataVector = blockDataList[mipmapIndex][repeatIndex];
 				blockDataVector.resize(blockAlignment.Count);
 
-				blockAlignment.iterate_chunks_breakable([&](const uint32_t index, const uint32_t offset, const uint32_t length) {
-					waiter.submit([this, offset, length, &blockData = blockDataVector[index]](auto& task) {
-						if (task.cancelled())
-							cancel();
-						if (!cancelled())
-							compress_block(offset, length, blockData);
-					});
-
-					return !cancelled();
+				blockAlignment.iterate_chunks([&](const uint32_t index, const uint32_t offset, const uint32_t length) {
+					jobs.emplace_back(block_job{offset, length, &blockDataVector[index]});
 				}, repeatedUnitOffset);
 			}
 		}
 
-		if (!cancelled())
-			waiter.wait_all();
+		util::thread_pool::parallel_for(jobs, 1, [this](const block_job& job) {
+			if (!cancelled())
+				compress_block(job.Offset, job.Length, *job.Target);
+		});
 	}
 
 	if (cancelled())
@@ -1,6 +1,8 @@
 #include "../include/xivres/sqpack.generator.h"
 
+#include <array>
 #include <fstream>
+#include <numeric>
 #include <ranges>
 
 #include "../include/xivres/packed_stream.hotswap.h"
@@ -27,19 +29,36 @@ std::vector<xivres::packed_stream*> xivres::sqpack::generator::add_result::all_s
 	return res;
 }
 
+// Sorts the same as path_spec::FullPathComparator does, as util::unicode::lower only maps ASCII letters.
+static std::string lowercase_path(const xivres::path_spec& pathSpec) {
+	std::string res(pathSpec.text());
+	for (auto& c : res) {
+		if ('A' <= c && c <= 'Z')
+			c += 'a' - 'A';
+	}
+	return res;
+}
+
+template<typename TKey>
+static xivres::sqpack::generator::entry_info* find_sorted_entry(std::span<const std::pair<TKey, xivres::sqpack::generator::entry_info*>> entries, const TKey& key) {
+	const auto it = std::ranges::lower_bound(entries, key, std::less(), [](const auto& entry) -> const TKey& { return entry.first; });
+	if (it == entries.end() || it->first != key)
+		return nullptr;
+	return it->second;
+}
+
 xivres::sqpack::generator::entry_info* xivres::sqpack::generator::sqpack_views::find_entry(const path_spec& pathSpec) const {
-	if (const auto it = HashOnlyEntries.find(pathSpec); it != HashOnlyEntries.end())
-		return it->second.get();
-	if (const auto it = FullPathEntries.find(pathSpec); it != FullPathEntries.end())
-		return it->second.get();
-	return nullptr;
+	if (const auto entry = find_sorted_entry<std::tuple<uint32_t, uint32_t, uint32_t>>(HashOnlyEntries, std::make_tuple(pathSpec.full_path_hash(), pathSpec.path_hash(), pathSpec.name_hash())))
+		return entry;
+	if (!pathSpec.has_original())
+		return nullptr;
+
+	return find_sorted_entry<std::string>(FullPathEntries, lowercase_path(pathSpec));
 }
 
 xivres::sqpack::generator::entry_info& xivres::sqpack::generator::sqpack_views::get_entry(const path_spec& pathSpec) const {
-	if (const auto it = HashOnlyEntries.find(pathSpec); it != HashOnlyEntries.end())
-		return *it->second;
-	if (const auto it = FullPathEntries.find(pathSpec); it != FullPathEntries.end())
-		return *it->second;
+	if (const auto entry = find_entry(pathSpec))
+		return *entry;
 	throw std::out_of_range("File not found");
 }
 
@@ -63,45 +82,236 @@ xivres::sqpack::generator::add_result& xivres::sqpack::generator::add_result::op
 	return *this;
 }
 
-void xivres::sqpack::generator::sqpack_view_entry_cache::buffered_entry::clear() {
-	m_view = nullptr;
-	m_entry = nullptr;
-	if (!m_bufferTemporary.empty())
-		std::vector<uint8_t>().swap(m_bufferTemporary);
+xivres::sqpack::generator::sqpack_view_entry_cache::sqpack_view_entry_cache(uint64_t maxBytes, size_t shardCount)
+	: m_maxBytes(maxBytes)
+	, m_maxBytesPerShard(maxBytes / (std::max<size_t>)(1, shardCount))
+	, m_shards((std::max<size_t>)(1, shardCount)) {
 }
 
-void xivres::sqpack::generator::sqpack_view_entry_cache::buffered_entry::set(const data_view_stream* view, const entry_info* entry) {
-	m_view = view;
-	m_entry = entry;
+std::shared_ptr<const xivres::sqpack::generator::sqpack_view_entry_cache::buffered_entry> xivres::sqpack::generator::sqpack_view_entry_cache::GetBuffer(const data_view_stream* view, const entry_info* entry) {
+	if (entry->EntrySize > m_maxBytesPerShard) {
+		++m_bypassedCount;
+		return nullptr;
+	}
 
-	if (entry->EntrySize <= SmallEntryBufferSize) {
-		if (!m_bufferTemporary.empty())
-			std::vector<uint8_t>().swap(m_bufferTemporary);
-		if (m_bufferPreallocated.size() != SmallEntryBufferSize)
-			m_bufferPreallocated.resize(SmallEntryBufferSize);
-		m_bufferActive = std::span(m_bufferPreallocated.begin(), entry->EntrySize);
-	} else {
-		m_bufferTemporary.resize(entry->EntrySize);
-		m_bufferActive = std::span(m_bufferTemporary);
+	auto& s = shard_of(entry);
+	std::shared_ptr<buffered_entry> res;
+	auto hit = false;
+	{
+		const auto lock = std::lock_guard(s.Mtx);
+		const auto key = std::make_pair(view, entry);
+		if (const auto it = s.Lookup.find(key); it != s.Lookup.end()) {
+			s.Entries.splice(s.Entries.begin(), s.Entries, it->second);
+			res = *it->second;
+			hit = true;
+		} else {
+			evict(s, m_maxBytesPerShard - entry->EntrySize);
+			res = std::make_shared<buffered_entry>(view, entry);
+			s.Entries.emplace_front(res);
+			s.Lookup.emplace(key, s.Entries.begin());
+			s.Bytes += entry->EntrySize;
+		}
+	}
+
+	// Read outside the lock, so that a slow provider only holds up the readers of the same entry.
+	try {
+		std::call_once(res->m_loaded, [&res, entry, this] {
+			std::vector<uint8_t> buf(entry->EntrySize);
+			entry->Provider->read_fully(0, std::span(buf));
+			res->m_buffer = std::move(buf);
+			++m_missCount;
+			m_missBytes += entry->EntrySize;
+		});
+	} catch (...) {
+		const auto lock = std::lock_guard(s.Mtx);
+		if (const auto it = s.Lookup.find(std::make_pair(view, entry)); it != s.Lookup.end() && *it->second == res) {
+			s.Bytes -= entry->EntrySize;
+			s.Entries.erase(it->second);
+			s.Lookup.erase(it);
+		}
+		throw;
+	}
+
+	if (hit) {
+		++m_hitCount;
+		m_hitBytes += entry->EntrySize;
 	}
-	entry->Provider->read_fully(0, m_bufferActive);
+	return res;
 }
 
-xivres::sqpack::generator::sqpack_view_entry_cache::buffered_entry* xivres::sqpack::generator::sqpack_view_entry_cache::GetBuffer(const data_view_stream* view, const entry_info* entry) {
-	if (m_lastActiveEntry.is_same(view, entry))
-		return &m_lastActiveEntry;
+void xivres::sqpack::generator::sqpack_view_entry_cache::Flush() {
+	for (auto& s : m_shards) {
+		const auto lock = std::lock_guard(s.Mtx);
+		s.Entries.clear();
+		s.Lookup.clear();
+		s.Bytes = 0;
+	}
+}
 
-	if (entry->EntrySize > LargeEntryBufferSizeMax)
-		return nullptr;
+void xivres::sqpack::generator::sqpack_view_entry_cache::Flush(const data_view_stream* view) {
+	for (auto& s : m_shards) {
+		const auto lock = std::lock_guard(s.Mtx);
+		for (auto it = s.Lookup.begin(); it != s.Lookup.end();) {
+			if (it->first.first == view) {
+				s.Bytes -= (*it->second)->m_size;
+				s.Entries.erase(it->second);
+				it = s.Lookup.erase(it);
+			} else
+				++it;
+		}
+	}
+}
+
+uint64_t xivres::sqpack::generator::sqpack_view_entry_cache::size() const {
+	uint64_t res = 0;
+	for (auto& s : m_shards) {
+		const auto lock = std::lock_guard(s.Mtx);
+		res += s.Bytes;
+	}
+	return res;
+}
+
+xivres::sqpack::generator::sqpack_view_entry_cache::stats xivres::sqpack::generator::sqpack_view_entry_cache::statistics() const {
+	return {
+		.HitCount = m_hitCount,
+		.MissCount = m_missCount,
+		.BypassedCount = m_bypassedCount,
+		.EvictedCount = m_evictedCount,
+		.HitBytes = m_hitBytes,
+		.MissBytes = m_missBytes,
+		.EvictedBytes = m_evictedBytes,
+	};
+}
+
+xivres::sqpack::generator::sqpack_view_entry_cache::shard& xivres::sqpack::generator::sqpack_view_entry_cache::shard_of(const entry_info* entry) {
+	return m_shards[reinterpret_cast<uintptr_t>(entry) / sizeof(entry_info) % m_shards.size()];
+}
+
+void xivres::sqpack::generator::sqpack_view_entry_cache::evict(shard& s, uint64_t targetBytes) {
+	while (s.Bytes > targetBytes && !s.Entries.empty()) {
+		const auto& victim = *s.Entries.back();
+		s.Bytes -= victim.m_size;
+		++m_evictedCount;
+		m_evictedBytes += victim.m_size;
+		s.Lookup.erase(victim.get());
+		s.Entries.pop_back();
+	}
+}
+
+struct xivres::sqpack::generator::progress_state {
+	static constexpr auto StageCount = static_cast<size_t>(export_stage::count);
+
+	std::atomic<std::chrono::milliseconds::rep> IntervalMilliseconds = 250;
+	std::chrono::steady_clock::time_point LastReport{};
+
+	mutable std::mutex Mtx;
+	export_stage Stage = export_stage::measure;
+	std::chrono::steady_clock::time_point Start{};
+	std::chrono::steady_clock::time_point StageStart{};
+	std::optional<std::chrono::steady_clock::time_point> End;
+
+	std::atomic_size_t EntryCount;
+	std::atomic_size_t ScannedEntryCount;
+	std::atomic_size_t MeasuredEntryCount;
+	std::atomic_size_t StoredEntryCount;
+	std::atomic_size_t CompletedEntryCount;
+	std::atomic_uint64_t PackedBytes;
+	std::atomic_uint64_t ReadBytes;
+	std::atomic_uint64_t WrittenBytes;
+	std::atomic_size_t PendingTaskCount;
+	std::atomic_size_t BufferedResultCount;
+
+	std::array<util::latency_histogram, StageCount> Histograms;
+
+	void begin(size_t entryCount) {
+		for (auto& histogram : Histograms)
+			histogram.reset();
+		EntryCount = entryCount;
+		ScannedEntryCount = MeasuredEntryCount = StoredEntryCount = CompletedEntryCount = PendingTaskCount = BufferedResultCount = 0;
+		PackedBytes = ReadBytes = WrittenBytes = 0;
+
+		const auto lock = std::lock_guard(Mtx);
+		Stage = export_stage::measure;
+		Start = StageStart = LastReport = std::chrono::steady_clock::now();
+		End.reset();
+	}
+
+	void enter(export_stage stage) {
+		const auto lock = std::lock_guard(Mtx);
+		Stage = stage;
+		StageStart = std::chrono::steady_clock::now();
+	}
+
+	void end() {
+		const auto lock = std::lock_guard(Mtx);
+		End = std::chrono::steady_clock::now();
+	}
+
+	void record(export_stage stage, std::chrono::steady_clock::duration elapsed) {
+		Histograms[static_cast<size_t>(stage)].record(elapsed);
+	}
+
+	[[nodiscard]] export_progress snapshot() const {
+		export_progress res;
+		{
+			const auto lock = std::lock_guard(Mtx);
+			const auto now = End.value_or(std::chrono::steady_clock::now());
+			res.Stage = Stage;
+			res.Elapsed = now - Start;
+			res.StageElapsed = now - StageStart;
+		}
+		res.EntryCount = EntryCount;
+		res.ScannedEntryCount = ScannedEntryCount;
+		res.MeasuredEntryCount = MeasuredEntryCount;
+		res.StoredEntryCount = StoredEntryCount;
+		res.CompletedEntryCount = CompletedEntryCount;
+		res.PackedBytes = PackedBytes;
+		res.ReadBytes = ReadBytes;
+		res.WrittenBytes = WrittenBytes;
+		res.PendingTaskCount = PendingTaskCount;
+		res.BufferedResultCount = BufferedResultCount;
+
+		for (size_t i = 0; i < StageCount; ++i)
+			res.Latency[i] = Histograms[i].stats();
+		return res;
+	}
+};
+
+double xivres::sqpack::generator::export_progress::entries_per_second() const {
+	const auto seconds = std::chrono::duration<double>(StageElapsed).count();
+	if (seconds <= 0)
+		return 0;
+	switch (Stage) {
+		case export_stage::deduplicate:
+			return static_cast<double>(ScannedEntryCount) / seconds;
+		case export_stage::measure:
+			return static_cast<double>(MeasuredEntryCount) / seconds;
+		default:
+			return static_cast<double>(CompletedEntryCount) / seconds;
+	}
+}
 
-	m_lastActiveEntry.set(view, entry);
-	return &m_lastActiveEntry;
+double xivres::sqpack::generator::export_progress::written_bytes_per_second() const {
+	const auto seconds = std::chrono::duration<double>(StageElapsed).count();
+	if (seconds <= 0)
+		return 0;
+	return static_cast<double>(WrittenBytes) / seconds;
+}
+
+std::chrono::steady_clock::duration xivres::sqpack::generator::export_progress::estimated_remaining() const {
+	// Deduplication scans every entry, and only the stored entries, known after it, get measured and written.
+	const auto done = ScannedEntryCount + MeasuredEntryCount + CompletedEntryCount;
+	const auto total = Stage == export_stage::deduplicate ? 3 * EntryCount : ScannedEntryCount + 2 * StoredEntryCount;
+	if (!done || done >= total)
+		return {};
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(Elapsed * (static_cast<double>(total - done) / static_cast<double>(done)));
 }
 
 xivres::sqpack::generator::generator(std::string ex, std::string name, uint64_t maxFileSize)
 	: m_maxFileSize(maxFileSize)
 	, DatExpac(std::move(ex))
-	, DatName(std::move(name)) {
+	, DatName(std::move(name))
+	, m_progress(std::make_shared<progress_state>()) {
 	if (maxFileSize > sqdata::header::MaxFileSize_MaxValue)
 		throw std::invalid_argument("MaxFileSize cannot be more than 32GiB.");
 }
@@ -112,15 +322,10 @@ void xivres::sqpack::generator::add(add_result& result, std::shared_ptr<packed_s
 	try {
 		entry_info* pEntry = nullptr;
 
-		if (const auto it = m_hashOnlyEntries.find(provider->path_spec()); it != m_hashOnlyEntries.end()) {
-			pEntry = it->second.get();
-			if (!pEntry->Provider->path_spec().has_original() && provider->path_spec().has_original()) {
+		if (const auto slot = find_slot(provider->path_spec()); slot != SIZE_MAX) {
+			pEntry = &m_entries[m_entrySlots[slot].Index];
+			if (!pEntry->Provider->path_spec().has_original() && provider->path_spec().has_original())
 				pEntry->Provider->update_path_spec(provider->path_spec());
-				m_fullEntries.emplace(pProvider->path_spec(), std::move(it->second));
-				m_hashOnlyEntries.erase(it);
-			}
-		} else if (const auto it = m_fullEntries.find(provider->path_spec()); it != m_fullEntries.end()) {
-			pEntry = it->second.get();
 		}
 
 		if (pEntry) {
@@ -130,15 +335,15 @@ void xivres::sqpack::generator::add(add_result& result, std::shared_ptr<packed_s
 				return;
 			}
 			pEntry->Provider = std::move(provider);
+			if (m_backgroundPacking)
+				pProvider->prepare_async();
 			result.Replaced.emplace_back(pProvider);
 			return;
 		}
 
-		auto entry = std::make_unique<entry_info>(0, sqindex::data_locator{0, 0}, std::move(provider));
-		if (pProvider->path_spec().has_original())
-			m_fullEntries.emplace(pProvider->path_spec(), std::move(entry));
-		else
-			m_hashOnlyEntries.emplace(pProvider->path_spec(), std::move(entry));
+		emplace_entry(0, std::move(provider));
+		if (m_backgroundPacking)
+			pProvider->prepare_async();
 		result.Added.emplace_back(pProvider);
 	} catch (const std::exception& e) {
 		result.Error.emplace_back(pProvider->path_spec(), e.what());
@@ -173,44 +378,418 @@ xivres::sqpack::generator::add_result xivres::sqpack::generator::add_sqpack(cons
 	return result;
 }
 
-xivres::sqpack::generator::add_result xivres::sqpack::generator::add_file(path_spec pathSpec, const std::filesystem::path& path, bool overwriteExisting) {
-	std::shared_ptr<packed_stream> provider;
+static std::shared_ptr<xivres::packed_stream> make_file_provider(xivres::path_spec pathSpec, const std::filesystem::path& path, uint64_t fileSize) {
+	using namespace xivres;
 
 	auto extensionLower = path.extension().u8string();
 	for (auto& c : extensionLower)
 		if (u8'A' <= c && c <= u8'Z')
 			c += 'a' - 'A';
 
-	if (file_size(path) == 0) {
-		provider = std::make_shared<placeholder_packed_stream>(std::move(pathSpec));
-	} else if (extensionLower == u8".tex" || extensionLower == u8".atex") {
-		provider = std::make_shared<passthrough_packed_stream<texture_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
-	} else if (extensionLower == u8".mdl") {
-		provider = std::make_shared<passthrough_packed_stream<model_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
-	} else {
-		provider = std::make_shared<passthrough_packed_stream<standard_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
+	if (fileSize == 0)
+		return std::make_shared<placeholder_packed_stream>(std::move(pathSpec));
+	if (extensionLower == u8".tex" || extensionLower == u8".atex")
+		return std::make_shared<passthrough_packed_stream<texture_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
+	if (extensionLower == u8".mdl")
+		return std::make_shared<passthrough_packed_stream<model_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
+	return std::make_shared<passthrough_packed_stream<standard_passthrough_packer>>(std::move(pathSpec), std::make_shared<file_stream>(path));
+}
+
+xivres::sqpack::generator::add_result xivres::sqpack::generator::add_file(path_spec pathSpec, const std::filesystem::path& path, bool overwriteExisting) {
+	return add(make_file_provider(std::move(pathSpec), path, file_size(path)), overwriteExisting);
+}
+
+xivres::sqpack::generator::add_result xivres::sqpack::generator::add_directory(const std::filesystem::path& root, const path_mapper& pathMapper, bool overwriteExisting) {
+	struct directory_listing {
+		std::vector<std::filesystem::path> Directories;
+		std::vector<std::pair<std::filesystem::path, uint64_t>> Files;
+	};
+
+	// List one level of the tree at a time; sizes come along with the listing on most platforms.
+	std::vector<std::pair<std::filesystem::path, uint64_t>> files;
+	for (std::vector directories{root}; !directories.empty();) {
+		util::thread_pool::task_waiter<directory_listing> waiter;
+		for (auto& directory : directories) {
+			waiter.submit([directory = std::move(directory)](util::thread_pool::base_task& task) {
+				directory_listing listing;
+				for (const auto& item : std::filesystem::directory_iterator(directory)) {
+					task.throw_if_cancelled();
+					if (item.is_symlink() && item.is_directory())
+						continue;
+					if (item.is_directory())
+						listing.Directories.emplace_back(item.path());
+					else if (item.is_regular_file())
+						listing.Files.emplace_back(item.path(), item.file_size());
+				}
+				return listing;
+			});
+		}
+
+		directories.clear();
+		while (auto listing = waiter.get()) {
+			directories.insert(directories.end(), std::make_move_iterator(listing->Directories.begin()), std::make_move_iterator(listing->Directories.end()));
+			files.insert(files.end(), std::make_move_iterator(listing->Files.begin()), std::make_move_iterator(listing->Files.end()));
+		}
+	}
+
+	// Listings complete in any order; keep the result independent of that.
+	std::ranges::sort(files);
+
+	std::vector<std::pair<path_spec, size_t>> mapped;
+	mapped.reserve(files.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		const auto relativePath = files[i].first.lexically_relative(root);
+		if (auto pathSpec = pathMapper ? pathMapper(relativePath) : std::optional<path_spec>(relativePath.generic_u8string()))
+			mapped.emplace_back(std::move(*pathSpec), i);
 	}
 
-	return add(provider, overwriteExisting);
+	struct opened_file {
+		size_t Index{};
+		std::shared_ptr<packed_stream> Provider;
+		std::string Error;
+	};
+
+	// Parse headers of passthrough packers ahead, so that export does not have to do it one at a time.
+	std::vector<opened_file> opened(mapped.size());
+	{
+		util::thread_pool::task_waiter<opened_file> waiter;
+		for (size_t i = 0; i < mapped.size(); ++i) {
+			waiter.submit([i, &pathSpec = mapped[i].first, &file = files[mapped[i].second]](util::thread_pool::base_task&) {
+				opened_file res{.Index = i};
+				try {
+					res.Provider = make_file_provider(pathSpec, file.first, file.second);
+					(void)res.Provider->size();
+				} catch (const std::exception& e) {
+					res.Provider = nullptr;
+					res.Error = e.what();
+				}
+				return res;
+			});
+		}
+
+		while (auto res = waiter.get())
+			opened[res->Index] = std::move(*res);
+	}
+
+	add_result result;
+	for (size_t i = 0; i < opened.size(); ++i) {
+		if (opened[i].Provider)
+			add(result, std::move(opened[i].Provider), overwriteExisting);
+		else
+			result.Error.emplace_back(mapped[i].first, std::move(opened[i].Error));
+	}
+	return result;
 }
 
 void xivres::sqpack::generator::reserve_space(path_spec pathSpec, uint32_t size) {
-	if (const auto it = m_hashOnlyEntries.find(pathSpec); it != m_hashOnlyEntries.end()) {
-		it->second->EntrySize = (std::max)(it->second->EntrySize, size);
-		if (!it->second->Provider->path_spec().has_original() && pathSpec.has_original()) {
-			it->second->Provider->update_path_spec(pathSpec);
-			m_fullEntries.emplace(pathSpec, std::move(it->second));
-			m_hashOnlyEntries.erase(it);
-		}
-	} else if (const auto it = m_fullEntries.find(pathSpec); it != m_fullEntries.end()) {
-		it->second->EntrySize = (std::max)(it->second->EntrySize, size);
+	if (const auto slot = find_slot(pathSpec); slot != SIZE_MAX) {
+		auto& entry = m_entries[m_entrySlots[slot].Index];
+		entry.EntrySize = (std::max)(entry.EntrySize, size);
+		if (!entry.Provider->path_spec().has_original() && pathSpec.has_original())
+			entry.Provider->update_path_spec(pathSpec);
 	} else {
-		auto entry = std::make_unique<entry_info>(size, sqindex::data_locator{0, 0}, std::make_shared<placeholder_packed_stream>(std::move(pathSpec)));
-		if (entry->Provider->path_spec().has_original())
-			m_fullEntries.emplace(entry->Provider->path_spec(), std::move(entry));
+		emplace_entry(size, std::make_shared<placeholder_packed_stream>(std::move(pathSpec)));
+	}
+}
+
+bool xivres::sqpack::generator::remove(const path_spec& pathSpec) {
+	const auto slot = find_slot(pathSpec);
+	if (slot == SIZE_MAX)
+		return false;
+
+	m_entries[m_entrySlots[slot].Index].Provider.reset();
+	m_entrySlots[slot].Index = entry_slot::Removed;
+	m_entryCount--;
+	return true;
+}
+
+size_t xivres::sqpack::generator::find_slot(const path_spec& pathSpec) const {
+	if (m_entrySlots.empty())
+		return SIZE_MAX;
+
+	// An entry without full path can be found with any full path of the same hashes; prefer that over an exact match.
+	auto fullPathMatch = SIZE_MAX;
+	const auto mask = m_entrySlots.size() - 1;
+	for (auto i = pathSpec.full_path_hash() & mask; m_entrySlots[i].Index != entry_slot::Empty; i = (i + 1) & mask) {
+		const auto& slot = m_entrySlots[i];
+		if (slot.Index == entry_slot::Removed || slot.FullPathHash != pathSpec.full_path_hash())
+			continue;
+
+		const auto& entryPathSpec = m_entries[slot.Index].Provider->path_spec();
+		if (!entryPathSpec.has_original()) {
+			if (path_spec::AllHashComparator::compare(entryPathSpec, pathSpec) == 0)
+				return i;
+		} else if (fullPathMatch == SIZE_MAX && path_spec::FullPathComparator::compare(entryPathSpec, pathSpec) == 0)
+			fullPathMatch = i;
+	}
+	return fullPathMatch;
+}
+
+xivres::sqpack::generator::entry_info& xivres::sqpack::generator::emplace_entry(uint32_t entrySize, std::shared_ptr<packed_stream> provider) {
+	if (m_entries.size() >= entry_slot::Removed)
+		throw std::length_error("Too many entries");
+
+	// Keep at most 3/4 of the slots occupied, counting the removed ones.
+	if ((m_occupiedEntrySlotCount + 1) * 4 > m_entrySlots.size() * 3)
+		rehash((std::max<size_t>)(1024, std::bit_ceil((m_entryCount + 1) * 2)));
+
+	const auto fullPathHash = provider->path_spec().full_path_hash();
+	auto& entry = m_entries.emplace_back(entrySize, sqindex::data_locator{0, 0}, std::move(provider));
+
+	const auto mask = m_entrySlots.size() - 1;
+	auto i = fullPathHash & mask;
+	while (m_entrySlots[i].Index != entry_slot::Empty)
+		i = (i + 1) & mask;
+	m_entrySlots[i] = {fullPathHash, static_cast<uint32_t>(m_entries.size() - 1)};
+	m_occupiedEntrySlotCount++;
+	m_entryCount++;
+	return entry;
+}
+
+void xivres::sqpack::generator::rehash(size_t slotCount) {
+	std::vector<entry_slot> slots(slotCount);
+	const auto mask = slotCount - 1;
+	for (const auto& slot : m_entrySlots) {
+		if (slot.Index == entry_slot::Empty || slot.Index == entry_slot::Removed)
+			continue;
+
+		auto i = slot.FullPathHash & mask;
+		while (slots[i].Index != entry_slot::Empty)
+			i = (i + 1) & mask;
+		slots[i] = slot;
+	}
+	m_entrySlots = std::move(slots);
+	m_occupiedEntrySlotCount = m_entryCount;
+}
+
+void xivres::sqpack::generator::take_sorted_entries(std::deque<entry_info>& storage, decltype(sqpack_views::HashOnlyEntries)& hashOnlyEntries, decltype(sqpack_views::FullPathEntries)& fullPathEntries) {
+	storage = std::move(m_entries);
+	m_entries.clear();
+	m_entrySlots.clear();
+	m_occupiedEntrySlotCount = 0;
+	m_entryCount = 0;
+
+	// Sort keys are made once beforehand; path_spec comparators would go through the providers, and decode the text, on every comparison.
+	hashOnlyEntries.clear();
+	fullPathEntries.clear();
+	for (auto& entry : storage) {
+		if (!entry.Provider)
+			continue;
+
+		const auto& pathSpec = entry.Provider->path_spec();
+		if (pathSpec.has_original())
+			fullPathEntries.emplace_back(lowercase_path(pathSpec), &entry);
+		else
+			hashOnlyEntries.emplace_back(std::make_tuple(pathSpec.full_path_hash(), pathSpec.path_hash(), pathSpec.name_hash()), &entry);
+	}
+	std::ranges::sort(hashOnlyEntries);
+	std::ranges::sort(fullPathEntries);
+}
+
+xivres::sqpack::generator& xivres::sqpack::generator::set_deduplicate(bool deduplicate) {
+	m_deduplicate = deduplicate;
+	return *this;
+}
+
+xivres::sqpack::generator& xivres::sqpack::generator::set_background_packing(bool backgroundPacking) {
+	m_backgroundPacking = backgroundPacking;
+	return *this;
+}
+
+xivres::sqpack::generator& xivres::sqpack::generator::set_progress_interval(std::chrono::milliseconds interval) {
+	m_progress->IntervalMilliseconds = interval.count();
+	return *this;
+}
+
+std::chrono::milliseconds xivres::sqpack::generator::progress_interval() const {
+	return std::chrono::milliseconds(m_progress->IntervalMilliseconds.load());
+}
+
+xivres::sqpack::generator::export_progress xivres::sqpack::generator::progress() const {
+	return m_progress->snapshot();
+}
+
+void xivres::sqpack::generator::report_progress(bool force) {
+	const auto now = std::chrono::steady_clock::now();
+	if (!force && now - m_progress->LastReport < std::chrono::milliseconds(m_progress->IntervalMilliseconds.load()))
+		return;
+	m_progress->LastReport = now;
+	ExportProgressCallback(m_progress->snapshot());
+}
+
+xivres::sqpack::generator& xivres::sqpack::generator::set_layout(layout_policy layout) {
+	m_layout = std::move(layout);
+	return *this;
+}
+
+void xivres::sqpack::generator::apply_layout(std::vector<entry_info*>& entries) const {
+	if (m_layout.Order == layout_order::index)
+		return;
+
+	using hash_key = std::tuple<uint32_t, uint32_t, uint32_t>;
+	const auto hash_key_of = [](const path_spec& pathSpec) { return std::make_tuple(pathSpec.full_path_hash(), pathSpec.path_hash(), pathSpec.name_hash()); };
+
+	// Listed entries are ranked by their position in the list, and the rest come after them.
+	std::map<hash_key, uint64_t> ranks;
+	if (m_layout.Order == layout_order::frequency) {
+		std::map<hash_key, uint64_t> totals;
+		for (const auto& [pathSpec, count] : m_layout.AccessCounts)
+			totals[hash_key_of(pathSpec)] += count;
+
+		std::vector<std::pair<hash_key, uint64_t>> sorted(totals.begin(), totals.end());
+		std::ranges::stable_sort(sorted, std::greater(), [](const auto& item) { return item.second; });
+		for (const auto& key : sorted | std::views::keys)
+			ranks.emplace(key, ranks.size());
+	} else if (m_layout.Order == layout_order::access_trace) {
+		for (const auto& pathSpec : m_layout.AccessTrace)
+			ranks.emplace(hash_key_of(pathSpec), ranks.size());
+	}
+
+	std::map<uint32_t, std::string> directories;
+	for (const auto entry : entries) {
+		if (const auto& pathSpec = entry->Provider->path_spec(); pathSpec.has_original()) {
+			auto path = lowercase_path(pathSpec);
+			path.resize(path.find_last_of('/') == std::string::npos ? 0 : path.find_last_of('/'));
+			directories.emplace(pathSpec.path_hash(), std::move(path));
+		}
+	}
+
+	// Rank, whether the directory is unknown, directory, path hash, whether the full path is unknown, file name, name hash, and original index.
+	using layout_key = std::tuple<uint64_t, bool, std::string, uint32_t, bool, std::string, uint32_t, size_t>;
+	std::vector<std::pair<layout_key, entry_info*>> keyed;
+	keyed.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const auto& pathSpec = entries[i]->Provider->path_spec();
+
+		uint64_t rank = 0;
+		if (m_layout.Order == layout_order::type)
+			rank = static_cast<uint64_t>(entries[i]->Provider->get_packed_type());
+		else if (m_layout.Order == layout_order::frequency || m_layout.Order == layout_order::access_trace) {
+			const auto it = ranks.find(hash_key_of(pathSpec));
+			rank = it == ranks.end() ? UINT64_MAX : it->second;
+		}
+
+		if (pathSpec.has_original()) {
+			auto path = lowercase_path(pathSpec);
+			const auto slash = path.find_last_of('/');
+			auto name = slash == std::string::npos ? path : path.substr(slash + 1);
+			path.resize(slash == std::string::npos ? 0 : slash);
+			keyed.emplace_back(layout_key{rank, false, std::move(path), pathSpec.path_hash(), false, std::move(name), pathSpec.name_hash(), i}, entries[i]);
+		} else if (const auto it = directories.find(pathSpec.path_hash()); it != directories.end())
+			keyed.emplace_back(layout_key{rank, false, it->second, pathSpec.path_hash(), true, std::string(), pathSpec.name_hash(), i}, entries[i]);
 		else
-			m_hashOnlyEntries.emplace(entry->Provider->path_spec(), std::move(entry));
+			keyed.emplace_back(layout_key{rank, true, std::string(), pathSpec.path_hash(), true, std::string(), pathSpec.name_hash(), i}, entries[i]);
 	}
+
+	std::ranges::sort(keyed, std::less(), [](const auto& item) -> const layout_key& { return item.first; });
+	for (size_t i = 0; i < entries.size(); ++i)
+		entries[i] = keyed[i].second;
+}
+
+std::vector<size_t> xivres::sqpack::generator::find_duplicate_entries(std::span<entry_info* const> entries) {
+	using digest_type = std::array<uint8_t, 20>;
+
+	m_progress->enter(export_stage::deduplicate);
+
+	std::vector<size_t> canonical(entries.size());
+	std::iota(canonical.begin(), canonical.end(), size_t{});
+
+	// Only entries of the same packed size can be identical, so only those get hashed.
+	std::map<std::streamsize, std::vector<size_t>> sizeGroups;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (!entries[i]->EntrySize)
+			sizeGroups[entries[i]->Provider->size()].emplace_back(i);
+		else
+			m_progress->ScannedEntryCount++;
+		report_progress(false);
+	}
+
+	std::vector<std::optional<digest_type>> digests(entries.size());
+	{
+		util::thread_pool::task_waiter<std::pair<size_t, digest_type>> waiter;
+		for (const auto& indices : sizeGroups | std::views::values) {
+			if (indices.size() < 2) {
+				m_progress->ScannedEntryCount += indices.size();
+				continue;
+			}
+
+			for (const auto i : indices) {
+				waiter.submit([this, i, entry = entries[i]](util::thread_pool::base_task& task) {
+					const auto start = std::chrono::steady_clock::now();
+					auto pooledBuffer = util::thread_pool::pooled_byte_buffer();
+					if (!pooledBuffer)
+						pooledBuffer.emplace();
+					auto& buffer = *pooledBuffer;
+					buffer.resize(65536);
+
+					util::hash_sha1 sha1;
+					const auto& provider = *entry->Provider;
+					align<uint64_t>(provider.size(), buffer.size()).iterate_chunks([&](uint64_t, uint64_t offset, uint64_t size) {
+						task.throw_if_cancelled();
+						provider.read_fully(static_cast<std::streamoff>(offset), &buffer[0], static_cast<std::streamsize>(size));
+						sha1.process_bytes(&buffer[0], static_cast<size_t>(size));
+					});
+
+					auto res = std::make_pair(i, digest_type{});
+					sha1.get_digest_bytes(res.second.data());
+					m_progress->record(export_stage::deduplicate, std::chrono::steady_clock::now() - start);
+					return res;
+				});
+			}
+		}
+
+		while (const auto res = waiter.get()) {
+			digests[res->first] = res->second;
+			m_progress->ScannedEntryCount++;
+			report_progress(false);
+		}
+	}
+
+	// Matching size and digest only make a candidate, as SHA-1 collisions can be crafted; the data get compared to be sure.
+	std::map<std::pair<std::streamsize, digest_type>, size_t> firstOccurrences;
+	std::vector<std::pair<size_t, size_t>> candidates;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (!digests[i])
+			continue;
+		if (const auto [it, inserted] = firstOccurrences.emplace(std::make_pair(entries[i]->Provider->size(), *digests[i]), i); !inserted)
+			candidates.emplace_back(i, it->second);
+	}
+
+	{
+		util::thread_pool::task_waiter<std::pair<size_t, size_t>> waiter;
+		for (const auto& [i, first] : candidates) {
+			waiter.submit([i, first, entry = entries[i], firstEntry = entries[first]](util::thread_pool::base_task& task) {
+				auto pooledBuffer1 = util::thread_pool::pooled_byte_buffer();
+				if (!pooledBuffer1)
+					pooledBuffer1.emplace();
+				auto pooledBuffer2 = util::thread_pool::pooled_byte_buffer();
+				if (!pooledBuffer2)
+					pooledBuffer2.emplace();
+				auto& buffer1 = *pooledBuffer1;
+				auto& buffer2 = *pooledBuffer2;
+				buffer1.resize(65536);
+				buffer2.resize(65536);
+
+				auto same = true;
+				const auto& provider = *entry->Provider;
+				const auto& firstProvider = *firstEntry->Provider;
+				align<uint64_t>(provider.size(), buffer1.size()).iterate_chunks_breakable([&](uint64_t, uint64_t offset, uint64_t size) {
+					task.throw_if_cancelled();
+					provider.read_fully(static_cast<std::streamoff>(offset), &buffer1[0], static_cast<std::streamsize>(size));
+					firstProvider.read_fully(static_cast<std::streamoff>(offset), &buffer2[0], static_cast<std::streamsize>(size));
+					same = memcmp(&buffer1[0], &buffer2[0], static_cast<size_t>(size)) == 0;
+					return same;
+				});
+
+				return std::make_pair(i, same ? first : i);
+			});
+		}
+
+		while (const auto res = waiter.get())
+			canonical[res->first] = res->second;
+	}
+
+	return canonical;
 }
 
 template<xivres::sqpack::sqindex::sqindex_type TSqIndex, typename TFileSegmentType, typename TTextSegmentType, bool UseFolders>
@@ -218,7 +797,7 @@ static std::vector<uint8_t> export_index_file_data(
 	size_t dataFilesCount,
 	std::vector<TFileSegmentType> fileSegment,
 	const std::vector<TTextSegmentType>& conflictSegment,
-	const std::vector<xivres::sqpack::sqindex::segment_3_entry>& segment3,
+	std::span<const xivres::sqpack::sqindex::segment_3_entry> segment3,
 	std::vector<xivres::sqpack::sqindex::path_hash_locator> folderSegment = {},
 	bool strict = false
 ) {
@@ -302,6 +881,100 @@ static std::vector<uint8_t> export_index_file_data(
 	return data;
 }
 
+std::pair<std::vector<uint8_t>, std::vector<uint8_t>> xivres::sqpack::generator::export_index_files_data(
+	std::span<const std::pair<path_spec, sqindex::data_locator>> entries,
+	size_t dataFilesCount,
+	std::span<const sqindex::segment_3_entry> index1Segment3,
+	std::span<const sqindex::segment_3_entry> index2Segment3,
+	bool strict
+) {
+	// Sorted once, keeping the given order among entries of the same hash, in place of a map of hashes to entries.
+	std::vector<const std::pair<path_spec, sqindex::data_locator>*> sorted;
+	sorted.reserve(entries.size());
+	for (const auto& entry : entries)
+		sorted.emplace_back(&entry);
+
+	const auto pairHashOf = [](const std::pair<path_spec, sqindex::data_locator>* entry) { return std::make_pair(entry->first.path_hash(), entry->first.name_hash()); };
+	std::ranges::stable_sort(sorted, std::less(), pairHashOf);
+
+	std::vector<sqindex::pair_hash_locator> fileEntries1;
+	std::vector<sqindex::pair_hash_with_text_locator> conflictEntries1;
+	for (auto it = sorted.begin(); it != sorted.end();) {
+		const auto pairHash = pairHashOf(*it);
+		const auto next = std::find_if(it, sorted.end(), [&](const auto* entry) { return pairHashOf(entry) != pairHash; });
+		const auto correspondingEntries = std::span(it, next);
+		it = next;
+
+		if (correspondingEntries.size() == 1) {
+			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, correspondingEntries.front()->second, 0});
+		} else {
+			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, sqindex::data_locator::Synonym(), 0});
+			uint32_t i = 0;
+			for (const auto& entry : correspondingEntries) {
+				conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
+					.NameHash = pairHash.second,
+					.PathHash = pairHash.first,
+					.Locator = entry->second,
+					.ConflictIndex = i++,
+				});
+				const auto& path = entry->first.text();
+				strncpy_s(conflictEntries1.back().FullPath, path.c_str(), path.size());
+			}
+		}
+	}
+	conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
+		.NameHash = sqindex::pair_hash_with_text_locator::EndOfList,
+		.PathHash = sqindex::pair_hash_with_text_locator::EndOfList,
+		.Locator = 0,
+		.ConflictIndex = sqindex::pair_hash_with_text_locator::EndOfList,
+	});
+
+	std::vector<sqindex::full_hash_locator> fileEntries2;
+	std::vector<sqindex::full_hash_with_text_locator> conflictEntries2;
+	const auto fullHashOf = [](const std::pair<path_spec, sqindex::data_locator>* entry) { return entry->first.full_path_hash(); };
+	sorted.clear();
+	for (const auto& entry : entries)
+		sorted.emplace_back(&entry);
+	std::ranges::stable_sort(sorted, std::less(), fullHashOf);
+
+	for (auto it = sorted.begin(); it != sorted.end();) {
+		const auto fullHash = fullHashOf(*it);
+		const auto next = std::find_if(it, sorted.end(), [&](const auto* entry) { return fullHashOf(entry) != fullHash; });
+		const auto correspondingEntries = std::span(it, next);
+		it = next;
+
+		if (correspondingEntries.size() == 1) {
+			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, correspondingEntries.front()->second});
+		} else {
+			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, sqindex::data_locator::Synonym()});
+			uint32_t i = 0;
+			for (const auto& entry : correspondingEntries) {
+				conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
+					.FullPathHash = fullHash,
+					.UnusedHash = 0,
+					.Locator = entry->second,
+					.ConflictIndex = i++,
+				});
+				const auto& path = entry->first.text();
+				strncpy_s(conflictEntries2.back().FullPath, path.c_str(), path.size());
+			}
+		}
+	}
+	conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
+		.FullPathHash = sqindex::full_hash_with_text_locator::EndOfList,
+		.UnusedHash = sqindex::full_hash_with_text_locator::EndOfList,
+		.Locator = 0,
+		.ConflictIndex = sqindex::full_hash_with_text_locator::EndOfList,
+	});
+
+	return {
+		export_index_file_data<sqindex::sqindex_type::Index, sqindex::pair_hash_locator, sqindex::pair_hash_with_text_locator, true>(
+			dataFilesCount, std::move(fileEntries1), conflictEntries1, index1Segment3, std::vector<sqindex::path_hash_locator>(), strict),
+		export_index_file_data<sqindex::sqindex_type::Index, sqindex::full_hash_locator, sqindex::full_hash_with_text_locator, false>(
+			dataFilesCount, std::move(fileEntries2), conflictEntries2, index2Segment3, std::vector<sqindex::path_hash_locator>(), strict),
+	};
+}
+
 class xivres::sqpack::generator::data_view_stream : public default_base_stream {
 	const std::vector<uint8_t> m_header;
 	const std::span<entry_info*> m_entries;
@@ -318,7 +991,7 @@ class xivres::sqpack::generator::data_view_stream : public default_base_stream {
 		return buffer;
 	}
 
-	mutable size_t m_lastAccessedEntryIndex = SIZE_MAX;
+	mutable std::atomic_size_t m_lastAccessedEntryIndex = SIZE_MAX;
 	const std::shared_ptr<sqpack_view_entry_cache> m_buffer;
 
 public:
@@ -328,6 +1001,11 @@ public:
 		, m_buffer(std::move(buffer)) {
 	}
 
+	~data_view_stream() override {
+		if (m_buffer)
+			m_buffer->Flush(this);
+	}
+
 	std::streamsize read(std::streamoff offset, void* buf, std::streamsize length) const override {
 		if (!length)
 			return 0;
@@ -347,7 +1025,8 @@ public:
 		if (out.empty())
 			return length;
 
-		auto it = m_lastAccessedEntryIndex != SIZE_MAX ? m_entries.begin() + static_cast<ptrdiff_t>(m_lastAccessedEntryIndex) : m_entries.begin();
+		const auto lastAccessedEntryIndex = m_lastAccessedEntryIndex.load(std::memory_order_relaxed);
+		auto it = lastAccessedEntryIndex != SIZE_MAX ? m_entries.begin() + static_cast<ptrdiff_t>(lastAccessedEntryIndex) : m_entries.begin();
 		if (const auto absoluteOffset = relativeOffset + m_header.size();
 			(*it)->Locator.offset() > absoluteOffset || absoluteOffset >= (*it)->Locator.offset() + (*it)->EntrySize) {
 			it = std::ranges::lower_bound(m_entries, nullptr, [&](entry_info* l, entry_info* r) {
@@ -364,11 +1043,10 @@ public:
 
 			for (; it < m_entries.end(); ++it) {
 				const auto& entry = **it;
-				m_lastAccessedEntryIndex = it - m_entries.begin();
-
-				const auto buf = m_buffer ? m_buffer->GetBuffer(this, &entry) : nullptr;
+				m_lastAccessedEntryIndex.store(it - m_entries.begin(), std::memory_order_relaxed);
 
 				if (relativeOffset < entry.EntrySize) {
+					const auto buf = m_buffer ? m_buffer->GetBuffer(this, &entry) : nullptr;
 					const auto available = (std::min)(out.size_bytes(), static_cast<size_t>(entry.EntrySize - relativeOffset));
 					if (buf)
 						std::copy_n(&buf->buffer()[static_cast<size_t>(relativeOffset)], available, &out[0]);
@@ -397,50 +1075,106 @@ xivres::sqpack::generator::sqpack_views xivres::sqpack::generator::export_to_vie
 	std::vector<sqdata::header> dataSubheaders;
 	std::vector<std::pair<size_t, size_t>> dataEntryRanges;
 
-	auto res = sqpack_views{
-		.HashOnlyEntries = std::move(m_hashOnlyEntries),
-		.FullPathEntries = std::move(m_fullEntries),
+	sqpack_views res;
+	take_sorted_entries(res.EntryStorage, res.HashOnlyEntries, res.FullPathEntries);
+	res.Entries.reserve(res.HashOnlyEntries.size() + res.FullPathEntries.size());
+	for (const auto entry : res.HashOnlyEntries | std::views::values)
+		res.Entries.emplace_back(entry);
+	for (const auto entry : res.FullPathEntries | std::views::values)
+		res.Entries.emplace_back(entry);
+	const auto indexOrder = res.Entries;
+	apply_layout(res.Entries);
+
+	// Every entry has to be packed to be laid out, so let them all be packed in parallel, instead of one by one as the layout gets computed.
+	for (const auto& entry : res.Entries)
+		entry->Provider->prepare_async();
+
+	m_lastExportStats = {};
+	m_progress->begin(res.Entries.size());
+
+	// Stored entries come first, so that each data view can refer to a contiguous range of res.Entries.
+	std::vector<std::pair<entry_info*, entry_info*>> duplicates;
+	if (m_deduplicate) {
+		const auto canonical = find_duplicate_entries(res.Entries);
+		m_progress->enter(export_stage::measure);
+		std::vector<entry_info*> stored;
+		stored.reserve(res.Entries.size());
+		for (size_t i = 0; i < res.Entries.size(); ++i) {
+			if (canonical[i] == i)
+				stored.emplace_back(res.Entries[i]);
+			else
+				duplicates.emplace_back(res.Entries[i], res.Entries[canonical[i]]);
+		}
+		for (const auto& duplicate : duplicates | std::views::keys)
+			stored.emplace_back(duplicate);
+		res.Entries = std::move(stored);
+	}
+	const auto storedEntryCount = res.Entries.size() - duplicates.size();
+	m_progress->StoredEntryCount = storedEntryCount;
+
+	std::vector<std::pair<path_spec, sqindex::data_locator>> indexEntries;
+	indexEntries.reserve(indexOrder.size());
+	for (const auto& entry : indexOrder)
+		indexEntries.emplace_back(entry->Provider->path_spec(), sqindex::data_locator());
+
+	// Data SHA-1 is computed as the entries get laid out; reads are done ahead on the pool, and hashed in order.
+	util::hash_sha1 dataSha1;
+	const auto finish_data_sha1 = [&] {
+		if (!strict || dataSubheaders.empty())
+			return;
+		auto& subheader = dataSubheaders.back();
+		dataSha1.get_digest_bytes(subheader.DataSha1.Value);
+		subheader.Sha1.set_from_span(reinterpret_cast<char*>(&subheader), offsetof(sqdata::header, Sha1));
+		dataSha1.reset();
 	};
 
-	res.Entries.reserve(m_fullEntries.size() + m_hashOnlyEntries.size());
-	for (auto& entry : res.HashOnlyEntries | std::views::values)
-		res.Entries.emplace_back(entry.get());
-	for (auto& entry : res.FullPathEntries | std::views::values)
-		res.Entries.emplace_back(entry.get());
-
-	std::map<std::pair<uint32_t, uint32_t>, std::vector<entry_info*>> pairHashes;
-	std::map<uint32_t, std::vector<entry_info*>> fullHashes;
-	for (const auto& entry : res.Entries) {
-		const auto& pathSpec = entry->Provider->path_spec();
-		pairHashes[std::make_pair(pathSpec.path_hash(), pathSpec.name_hash())].emplace_back(entry);
-		fullHashes[pathSpec.full_path_hash()].emplace_back(entry);
-	}
+	util::thread_pool::task_waiter<std::pair<size_t, std::vector<uint8_t>>> readWaiter;
+	std::map<size_t, std::vector<uint8_t>> readAhead;
+	size_t nextReadIndex = 0;
 
-	for (size_t i = 0; i < res.Entries.size(); ++i) {
-		ProgressCallback(i, res.Entries.size());
+	for (size_t i = 0; i < storedEntryCount; ++i) {
 		auto& entry = res.Entries[i];
 		const auto& pathSpec = entry->Provider->path_spec();
-		entry->EntrySize = align((std::max)(entry->EntrySize, static_cast<uint32_t>(entry->Provider->size()))).Alloc;
+
+		const auto measureStart = std::chrono::steady_clock::now();
+		const auto packedSize = static_cast<uint32_t>(entry->Provider->size());
+		m_progress->record(export_stage::measure, std::chrono::steady_clock::now() - measureStart);
+		m_progress->MeasuredEntryCount++;
+		m_progress->PackedBytes += packedSize;
+		entry->EntrySize = align((std::max)(entry->EntrySize, packedSize)).Alloc;
+
+		std::vector<uint8_t> data;
+		if (strict) {
+			for (; nextReadIndex < storedEntryCount && readWaiter.pending() < (std::max<size_t>)(8, 2 * readWaiter.pool().concurrency()); ++nextReadIndex) {
+				readWaiter.submit([this, j = nextReadIndex, provider = res.Entries[nextReadIndex]->Provider](util::thread_pool::base_task& task) {
+					task.throw_if_cancelled();
+					const auto start = std::chrono::steady_clock::now();
+					auto res = std::make_pair(j, provider->read_vector<uint8_t>());
+					m_progress->record(export_stage::read, std::chrono::steady_clock::now() - start);
+					m_progress->ReadBytes += res.second.size();
+					return res;
+				});
+			}
+			m_progress->PendingTaskCount = readWaiter.pending();
+			m_progress->BufferedResultCount = readAhead.size();
+
+			while (!readAhead.contains(i)) {
+				auto result = readWaiter.get();
+				if (!result)
+					throw std::logic_error("Read of an entry was not scheduled");
+				readAhead.emplace(result->first, std::move(result->second));
+			}
+
+			const auto it = readAhead.find(i);
+			data = std::move(it->second);
+			readAhead.erase(it);
+		}
+
 		entry->Provider = std::make_shared<hotswap_packed_stream>(pathSpec, entry->EntrySize, std::move(entry->Provider));
 
 		if (dataSubheaders.empty() ||
 			sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize + entry->EntrySize > dataSubheaders.back().MaxFileSize) {
-			if (strict && !dataSubheaders.empty()) {
-				util::hash_sha1 sha1;
-				for (auto j = dataEntryRanges.back().first, j_ = j + dataEntryRanges.back().second; j < j_; ++j) {
-					const auto& entry = res.Entries[j];
-					const auto& provider = *entry->Provider;
-					const auto length = provider.size();
-					uint8_t buf[4096];
-					for (std::streamoff j = 0; j < length; j += sizeof buf) {
-						const auto readlen = static_cast<size_t>((std::min<uint64_t>)(sizeof buf, length - j));
-						provider.read_fully(j, buf, static_cast<std::streamsize>(readlen));
-						sha1.process_bytes(buf, readlen);
-					}
-				}
-				sha1.get_digest_bytes(dataSubheaders.back().DataSha1.Value);
-				dataSubheaders.back().Sha1.set_from_span(reinterpret_cast<char*>(&dataSubheaders.back()), offsetof(sqdata::header, Sha1));
-			}
+			finish_data_sha1();
 			dataSubheaders.emplace_back(sqdata::header{
 				.HeaderSize = sizeof(sqdata::header),
 				.Unknown1 = sqdata::header::Unknown1_Value,
@@ -453,80 +1187,35 @@ xivres::sqpack::generator::sqpack_views xivres::sqpack::generator::export_to_vie
 
 		entry->Locator = {static_cast<uint32_t>(dataSubheaders.size() - 1), sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize};
 
+		if (strict) {
+			// Hotswap streams read the area past the underlying stream as zeroes.
+			static constexpr uint8_t Zeroes[EntryAlignment]{};
+			dataSha1.process_bytes(data.data(), data.size());
+			for (auto remaining = entry->EntrySize - data.size(); remaining;) {
+				const auto len = (std::min<size_t>)(remaining, sizeof Zeroes);
+				dataSha1.process_bytes(Zeroes, len);
+				remaining -= len;
+			}
+		}
+
 		dataSubheaders.back().DataSize = dataSubheaders.back().DataSize + entry->EntrySize;
 		dataEntryRanges.back().second++;
-	}
 
-	if (strict && !dataSubheaders.empty()) {
-		util::hash_sha1 sha1;
-		for (auto j = dataEntryRanges.back().first, j_ = j + dataEntryRanges.back().second; j < j_; ++j) {
-			const auto& entry = res.Entries[j];
-			const auto& provider = *entry->Provider;
-			const auto length = provider.size();
-			uint8_t buf[4096];
-			for (std::streamoff j = 0; j < length; j += sizeof buf) {
-				const auto readlen = static_cast<size_t>((std::min<uint64_t>)(sizeof buf, length - j));
-				provider.read_fully(j, buf, static_cast<std::streamsize>(readlen));
-				sha1.process_bytes(buf, readlen);
-			}
-		}
-		sha1.get_digest_bytes(dataSubheaders.back().DataSha1.Value);
-		dataSubheaders.back().Sha1.set_from_span(reinterpret_cast<char*>(&dataSubheaders.back()), offsetof(sqdata::header, Sha1));
+		ProgressCallback(i + 1, storedEntryCount);
+		m_progress->CompletedEntryCount++;
+		report_progress(false);
 	}
 
-	std::vector<sqindex::pair_hash_locator> fileEntries1;
-	std::vector<sqindex::pair_hash_with_text_locator> conflictEntries1;
-	for (const auto& [pairHash, correspondingEntries] : pairHashes) {
-		if (correspondingEntries.size() == 1) {
-			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, correspondingEntries.front()->Locator, 0});
-		} else {
-			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, sqindex::data_locator::Synonym(), 0});
-			uint32_t i = 0;
-			for (const auto& entry : correspondingEntries) {
-				conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
-					.NameHash = pairHash.second,
-					.PathHash = pairHash.first,
-					.Locator = entry->Locator,
-					.ConflictIndex = i++,
-				});
-				const auto& path = entry->Provider->path_spec().text();
-				strncpy_s(conflictEntries1.back().FullPath, path.c_str(), path.size());
-			}
-		}
-	}
-	conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
-		.NameHash = sqindex::pair_hash_with_text_locator::EndOfList,
-		.PathHash = sqindex::pair_hash_with_text_locator::EndOfList,
-		.Locator = 0,
-		.ConflictIndex = sqindex::pair_hash_with_text_locator::EndOfList,
-	});
+	finish_data_sha1();
 
-	std::vector<sqindex::full_hash_locator> fileEntries2;
-	std::vector<sqindex::full_hash_with_text_locator> conflictEntries2;
-	for (const auto& [fullHash, correspondingEntries] : fullHashes) {
-		if (correspondingEntries.size() == 1) {
-			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, correspondingEntries.front()->Locator});
-		} else {
-			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, sqindex::data_locator::Synonym()});
-			uint32_t i = 0;
-			for (const auto& entry : correspondingEntries) {
-				conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
-					.FullPathHash = fullHash,
-					.UnusedHash = 0,
-					.Locator = entry->Locator,
-					.ConflictIndex = i++,
-				});
-				const auto& path = entry->Provider->path_spec().text();
-				strncpy_s(conflictEntries2.back().FullPath, path.c_str(), path.size());
-			}
-		}
+	// Duplicates share the stored copy's hotswap stream, as swapping one of them alone cannot be represented anymore.
+	for (const auto& [duplicate, stored] : duplicates) {
+		duplicate->EntrySize = stored->EntrySize;
+		duplicate->Locator = stored->Locator;
+		duplicate->Provider = stored->Provider;
+		m_lastExportStats.DeduplicatedEntryCount++;
+		m_lastExportStats.DeduplicatedBytes += stored->EntrySize;
 	}
-	conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
-		.FullPathHash = sqindex::full_hash_with_text_locator::EndOfList,
-		.UnusedHash = sqindex::full_hash_with_text_locator::EndOfList,
-		.Locator = 0,
-		.ConflictIndex = sqindex::full_hash_with_text_locator::EndOfList,
-	});
 
 	memcpy(dataHeader.Signature, header::Signature_Value, sizeof(header::Signature_Value));
 	dataHeader.HeaderSize = sizeof header;
@@ -536,13 +1225,16 @@ xivres::sqpack::generator::sqpack_views xivres::sqpack::generator::export_to_vie
 	if (strict)
 		dataHeader.Sha1.set_from_span(reinterpret_cast<char*>(&dataHeader), offsetof(sqpack::header, Sha1));
 
-	res.Index1 = std::make_shared<memory_stream>(export_index_file_data<sqindex::sqindex_type::Index, sqindex::pair_hash_locator, sqindex::pair_hash_with_text_locator, true>(
-		dataSubheaders.size(), std::move(fileEntries1), conflictEntries1, m_sqpackIndexSegment3, std::vector<sqindex::path_hash_locator>(), strict));
-	res.Index2 = std::make_shared<memory_stream>(export_index_file_data<sqindex::sqindex_type::Index, sqindex::full_hash_locator, sqindex::full_hash_with_text_locator, false>(
-		dataSubheaders.size(), std::move(fileEntries2), conflictEntries2, m_sqpackIndex2Segment3, std::vector<sqindex::path_hash_locator>(), strict));
+	for (size_t i = 0; i < indexOrder.size(); ++i)
+		indexEntries[i].second = indexOrder[i]->Locator;
+	auto [index1, index2] = export_index_files_data(indexEntries, dataSubheaders.size(), m_sqpackIndexSegment3, m_sqpackIndex2Segment3, strict);
+	res.Index1 = std::make_shared<memory_stream>(std::move(index1));
+	res.Index2 = std::make_shared<memory_stream>(std::move(index2));
 	for (size_t i = 0; i < dataSubheaders.size(); ++i)
 		res.Data.emplace_back(std::make_shared<data_view_stream>(dataHeader, dataSubheaders[i], std::span(res.Entries).subspan(dataEntryRanges[i].first, dataEntryRanges[i].second), dataBuffer));
 
+	m_progress->end();
+	report_progress(true);
 	return res;
 }
 
@@ -558,74 +1250,123 @@ void xivres::sqpack::generator::export_to_files(const std::filesystem::path& dir
 
 	std::vector<sqdata::header> dataSubheaders;
 
-	std::vector<std::unique_ptr<entry_info>> entries;
-	entries.reserve(m_fullEntries.size() + m_hashOnlyEntries.size());
-	for (auto& val : m_fullEntries | std::views::values)
-		entries.emplace_back(std::move(val));
-	for (auto& val : m_hashOnlyEntries | std::views::values)
-		entries.emplace_back(std::move(val));
-	m_fullEntries.clear();
-	m_hashOnlyEntries.clear();
-
-	std::map<std::pair<uint32_t, uint32_t>, std::vector<entry_info*>> pairHashes;
-	std::map<uint32_t, std::vector<entry_info*>> fullHashes;
-	std::map<entry_info*, path_spec> entryPathSpecs;
-	for (const auto& entry : entries) {
-		const auto& pathSpec = entry->Provider->path_spec();
-		entryPathSpecs.emplace(entry.get(), pathSpec);
-		pairHashes[std::make_pair(pathSpec.path_hash(), pathSpec.name_hash())].emplace_back(entry.get());
-		fullHashes[pathSpec.full_path_hash()].emplace_back(entry.get());
+	std::deque<entry_info> entryStorage;
+	std::vector<entry_info*> entries;
+	{
+		decltype(sqpack_views::HashOnlyEntries) hashOnlyEntries;
+		decltype(sqpack_views::FullPathEntries) fullPathEntries;
+		take_sorted_entries(entryStorage, hashOnlyEntries, fullPathEntries);
+		entries.reserve(hashOnlyEntries.size() + fullPathEntries.size());
+		for (const auto entry : fullPathEntries | std::views::values)
+			entries.emplace_back(entry);
+		for (const auto entry : hashOnlyEntries | std::views::values)
+			entries.emplace_back(entry);
 	}
-
-	std::vector<sqindex::data_locator> locators;
-
+	const auto indexOrder = entries;
+	apply_layout(entries);
+
+	std::vector<std::pair<path_spec, sqindex::data_locator>> indexEntries;
+	indexEntries.reserve(indexOrder.size());
+	for (const auto& entry : indexOrder)
+		indexEntries.emplace_back(entry->Provider->path_spec(), sqindex::data_locator());
+
+	m_lastExportStats = {};
+	m_progress->begin(entries.size());
+
+	std::vector<size_t> canonical(entries.size());
+	if (m_deduplicate)
+		canonical = find_duplicate_entries(entries);
+	else
+		std::iota(canonical.begin(), canonical.end(), size_t{});
+
+	size_t storedEntryCount = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (canonical[i] == i)
+			storedEntryCount++;
+	}
+	m_progress->StoredEntryCount = storedEntryCount;
+	m_progress->enter(export_stage::write);
+
+	// Entries are packed and read ahead on the pool, and laid out in order as they come in, so that locators do not depend on
+	// how the threads get scheduled, and only the entries within the window are kept in memory.
+	// Laid out entries are written at their locators on the pool, and the data SHA-1 is computed in layout order as they go.
+	std::deque<positional_file_writer> dataFiles;
+	std::vector<util::hash_sha1> dataSha1s;
 	{
-		util::thread_pool::task_waiter<std::pair<size_t, std::vector<char>>> waiter;
-		std::fstream dataFile;
-
-		for (size_t i = 0;;) {
-			for (; i < entries.size() && waiter.pending() < (std::max<size_t>)(8, 2 * waiter.pool().concurrency()); ++i) {
-				waiter.submit([this, i, entry = entries[i].get()](util::thread_pool::base_task& task) {
+		util::thread_pool::task_waiter<std::tuple<size_t, uint64_t, std::vector<char>>> readWaiter;
+		util::thread_pool::task_waiter<uint64_t> writeWaiter;
+		std::map<size_t, std::pair<uint64_t, std::vector<char>>> readAhead;
+		const auto window = (std::max<size_t>)(8, 2 * readWaiter.pool().concurrency());
+		size_t nextReadIndex = 0;
+		size_t completedCount = 0;
+
+		const auto submit_reads = [&] {
+			for (; nextReadIndex < entries.size() && readWaiter.pending() + readAhead.size() + writeWaiter.pending() < window; ++nextReadIndex) {
+				if (canonical[nextReadIndex] != nextReadIndex)
+					continue;
+
+				readWaiter.submit([this, j = nextReadIndex, entry = entries[nextReadIndex]](util::thread_pool::base_task& task) {
 					task.throw_if_cancelled();
-					return std::make_pair(i, entry->Provider->read_vector<char>());
+					const auto& provider = *entry->Provider;
+
+					auto start = std::chrono::steady_clock::now();
+					const auto size = static_cast<uint64_t>(provider.size());
+					auto now = std::chrono::steady_clock::now();
+					m_progress->record(export_stage::measure, now - start);
+
+					start = now;
+					auto data = provider.read_vector<char>();
+					m_progress->record(export_stage::read, std::chrono::steady_clock::now() - start);
+					m_progress->ReadBytes += data.size();
+					return std::make_tuple(j, size, std::move(data));
 				});
-				ProgressCallback(i, entries.size());
 			}
-
-			const auto resultPair = waiter.get();
-			if (!resultPair)
+			m_progress->PendingTaskCount = readWaiter.pending() + writeWaiter.pending();
+			m_progress->BufferedResultCount = readAhead.size();
+		};
+
+		const auto on_written = [&] {
+			ProgressCallback(++completedCount, storedEntryCount);
+			m_progress->CompletedEntryCount = completedCount;
+			report_progress(false);
+		};
+
+		for (size_t i = 0;; ++i) {
+			submit_reads();
+
+			while (i < entries.size() && canonical[i] != i)
+				++i;
+			if (i == entries.size())
 				break;
 
-			auto& entry = *entries[resultPair->first];
-			auto& data = resultPair->second;
-			const auto provider{std::move(entry.Provider)};
-			const auto entrySize = provider->size();
+			while (!readAhead.contains(i)) {
+				if (nextReadIndex > i) {
+					auto result = readWaiter.get();
+					if (!result)
+						throw std::logic_error("Read of an entry was not scheduled");
+					auto& [j, size, data] = *result;
+					readAhead.emplace(j, std::make_pair(size, std::move(data)));
+				} else {
+					// The window is taken by writes; wait for one of them, so that the read of this entry can be scheduled.
+					if (!writeWaiter.get())
+						throw std::logic_error("Window is full without any write scheduled");
+					on_written();
+					submit_reads();
+				}
+			}
+
+			const auto it = readAhead.find(i);
+			const auto entrySize = it->second.first;
+			const auto data = std::make_shared<std::vector<char>>(std::move(it->second.second));
+			readAhead.erase(it);
+
+			auto& entry = *entries[i];
+			entry.Provider.reset();
+			m_progress->MeasuredEntryCount++;
+			m_progress->PackedBytes += entrySize;
 
 			if (dataSubheaders.empty() ||
 				sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize + entrySize > dataSubheaders.back().MaxFileSize) {
-				if (!dataSubheaders.empty() && dataFile.is_open()) {
-					if (strict) {
-						std::vector<char> buf(65536);
-						util::hash_sha1 sha1;
-						dataFile.seekg(sizeof header + sizeof(sqdata::header), std::ios::beg);
-						align<uint64_t>(dataSubheaders.back().DataSize, buf.size()).iterate_chunks([&](uint64_t index, uint64_t offset, uint64_t size) {
-							dataFile.read(&buf[0], static_cast<size_t>(size));
-							if (!dataFile)
-								throw std::runtime_error("Failed to read from output data file.");
-							sha1.process_bytes(&buf[0], static_cast<size_t>(size));
-						}, sizeof header + sizeof(sqdata::header));
-
-						sha1.get_digest_bytes(dataSubheaders.back().DataSha1.Value);
-						dataSubheaders.back().Sha1.set_from_span(reinterpret_cast<char*>(&dataSubheaders.back()), offsetof(sqdata::header, Sha1));
-					}
-
-					dataFile.seekp(0, std::ios::beg);
-					dataFile.write(reinterpret_cast<const char*>(&dataHeader), sizeof dataHeader);
-					dataFile.write(reinterpret_cast<const char*>(&dataSubheaders.back()), sizeof dataSubheaders.back());
-					dataFile.close();
-				}
-
-				dataFile.open(dir / std::format("{}.win32.dat{}", DatName, dataSubheaders.size()), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
 				dataSubheaders.emplace_back(sqdata::header{
 					.HeaderSize = sizeof(sqdata::header),
 					.Unknown1 = sqdata::header::Unknown1_Value,
@@ -633,117 +1374,76 @@ void xivres::sqpack::generator::export_to_files(const std::filesystem::path& dir
 					.SpanIndex = static_cast<uint32_t>(dataSubheaders.size()),
 					.MaxFileSize = m_maxFileSize,
 				});
+				dataFiles.emplace_back(dir / std::format("{}.win32.dat{}", DatName, dataSubheaders.size() - 1));
+				dataSha1s.emplace_back();
 			}
 
 			entry.Locator = {static_cast<uint32_t>(dataSubheaders.size() - 1), sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize};
-			dataFile.seekg(static_cast<std::streamoff>(entry.Locator.offset()), std::ios::beg);
-			dataFile.write(&data[0], static_cast<std::streamsize>(data.size()));
-			if (!dataFile)
-				throw std::runtime_error("Failed to write to output data file.");
-
 			dataSubheaders.back().DataSize = dataSubheaders.back().DataSize + entrySize;
-		}
-
-		if (!dataSubheaders.empty() && dataFile.is_open()) {
-			if (strict) {
-				std::vector<char> buf(65536);
-				util::hash_sha1 sha1;
-				dataFile.seekg(sizeof header + sizeof(sqdata::header), std::ios::beg);
-				align<uint64_t>(dataSubheaders.back().DataSize, buf.size()).iterate_chunks([&](uint64_t index, uint64_t offset, uint64_t size) {
-					dataFile.read(&buf[0], static_cast<size_t>(size));
-					if (!dataFile)
-						throw std::runtime_error("Failed to read from output data file.");
-					sha1.process_bytes(&buf[0], static_cast<size_t>(size));
-				}, sizeof header + sizeof(sqdata::header));
-
-				sha1.get_digest_bytes(dataSubheaders.back().DataSha1.Value);
-				dataSubheaders.back().Sha1.set_from_span(reinterpret_cast<char*>(&dataSubheaders.back()), offsetof(sqdata::header, Sha1));
-			}
+			if (strict)
+				dataSha1s.back().process_bytes(data->data(), data->size());
+
+			writeWaiter.submit([this, &dataFile = dataFiles.back(), offset = entry.Locator.offset(), data](util::thread_pool::base_task& task) {
+				task.throw_if_cancelled();
+				const auto start = std::chrono::steady_clock::now();
+				dataFile.write(offset, data->data(), data->size());
+				m_progress->record(export_stage::write, std::chrono::steady_clock::now() - start);
+				m_progress->WrittenBytes += data->size();
+				return static_cast<uint64_t>(data->size());
+			});
 
-			dataFile.seekp(0, std::ios::beg);
-			dataFile.write(reinterpret_cast<const char*>(&dataHeader), sizeof dataHeader);
-			dataFile.write(reinterpret_cast<const char*>(&dataSubheaders.back()), sizeof dataSubheaders.back());
-			dataFile.close();
+			while (writeWaiter.get(std::chrono::steady_clock::now()))
+				on_written();
 		}
+
+		while (writeWaiter.get())
+			on_written();
 	}
 
-	std::vector<sqindex::pair_hash_locator> fileEntries1;
-	std::vector<sqindex::pair_hash_with_text_locator> conflictEntries1;
-	for (const auto& [pairHash, correspondingEntries] : pairHashes) {
-		if (correspondingEntries.size() == 1) {
-			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, correspondingEntries.front()->Locator, 0});
-		} else {
-			fileEntries1.emplace_back(sqindex::pair_hash_locator{pairHash.second, pairHash.first, sqindex::data_locator::Synonym(), 0});
-			uint32_t i = 0;
-			for (const auto& entry : correspondingEntries) {
-				conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
-					.NameHash = pairHash.second,
-					.PathHash = pairHash.first,
-					.Locator = entry->Locator,
-					.ConflictIndex = i++,
-				});
-				const auto& path = entryPathSpecs[entry].text();
-				strncpy_s(conflictEntries1.back().FullPath, path.c_str(), path.size());
-			}
+	for (size_t i = 0; i < dataSubheaders.size(); ++i) {
+		auto& subheader = dataSubheaders[i];
+		if (strict) {
+			dataSha1s[i].get_digest_bytes(subheader.DataSha1.Value);
+			subheader.Sha1.set_from_span(reinterpret_cast<char*>(&subheader), offsetof(sqdata::header, Sha1));
 		}
+		dataFiles[i].write(0, &dataHeader, sizeof dataHeader);
+		dataFiles[i].write(sizeof dataHeader, &subheader, sizeof subheader);
 	}
-	conflictEntries1.emplace_back(sqindex::pair_hash_with_text_locator{
-		.NameHash = sqindex::pair_hash_with_text_locator::EndOfList,
-		.PathHash = sqindex::pair_hash_with_text_locator::EndOfList,
-		.Locator = 0,
-		.ConflictIndex = sqindex::pair_hash_with_text_locator::EndOfList,
-	});
+	dataFiles.clear();
 
-	std::vector<sqindex::full_hash_locator> fileEntries2;
-	std::vector<sqindex::full_hash_with_text_locator> conflictEntries2;
-	for (const auto& [fullHash, correspondingEntries] : fullHashes) {
-		if (correspondingEntries.size() == 1) {
-			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, correspondingEntries.front()->Locator});
-		} else {
-			fileEntries2.emplace_back(sqindex::full_hash_locator{fullHash, sqindex::data_locator::Synonym()});
-			uint32_t i = 0;
-			for (const auto& entry : correspondingEntries) {
-				conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
-					.FullPathHash = fullHash,
-					.UnusedHash = 0,
-					.Locator = entry->Locator,
-					.ConflictIndex = i++,
-				});
-				const auto& path = entryPathSpecs[entry].text();
-				strncpy_s(conflictEntries2.back().FullPath, path.c_str(), path.size());
-			}
-		}
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (canonical[i] == i)
+			continue;
+
+		entries[i]->Locator = entries[canonical[i]]->Locator;
+		m_lastExportStats.DeduplicatedEntryCount++;
+		m_lastExportStats.DeduplicatedBytes += static_cast<uint64_t>(entries[i]->Provider->size());
+		entries[i]->Provider.reset();
 	}
-	conflictEntries2.emplace_back(sqindex::full_hash_with_text_locator{
-		.FullPathHash = sqindex::full_hash_with_text_locator::EndOfList,
-		.UnusedHash = sqindex::full_hash_with_text_locator::EndOfList,
-		.Locator = 0,
-		.ConflictIndex = sqindex::full_hash_with_text_locator::EndOfList,
-	});
 
-	auto indexData = export_index_file_data<sqindex::sqindex_type::Index, sqindex::pair_hash_locator, sqindex::pair_hash_with_text_locator, true>(
-		dataSubheaders.size(), std::move(fileEntries1), conflictEntries1, m_sqpackIndexSegment3, std::vector<sqindex::path_hash_locator>(), strict);
-	std::ofstream(dir / std::format("{}.win32.index", DatName), std::ios::binary).write(reinterpret_cast<const char*>(&indexData[0]), indexData.size());
+	for (size_t i = 0; i < indexOrder.size(); ++i)
+		indexEntries[i].second = indexOrder[i]->Locator;
 
-	indexData = export_index_file_data<sqindex::sqindex_type::Index, sqindex::full_hash_locator, sqindex::full_hash_with_text_locator, false>(
-		dataSubheaders.size(), std::move(fileEntries2), conflictEntries2, m_sqpackIndex2Segment3, std::vector<sqindex::path_hash_locator>(), strict);
-	std::ofstream(dir / std::format("{}.win32.index2", DatName), std::ios::binary).write(reinterpret_cast<const char*>(&indexData[0]), indexData.size());
+	const auto [index1, index2] = export_index_files_data(indexEntries, dataSubheaders.size(), m_sqpackIndexSegment3, m_sqpackIndex2Segment3, strict);
+	std::ofstream(dir / std::format("{}.win32.index", DatName), std::ios::binary).write(reinterpret_cast<const char*>(&index1[0]), index1.size());
+	std::ofstream(dir / std::format("{}.win32.index2", DatName), std::ios::binary).write(reinterpret_cast<const char*>(&index2[0]), index2.size());
+
+	m_progress->end();
+	report_progress(true);
 }
 
 std::unique_ptr<xivres::default_base_stream> xivres::sqpack::generator::get(const path_spec& pathSpec) const {
-	if (const auto it = m_hashOnlyEntries.find(pathSpec); it != m_hashOnlyEntries.end())
-		return std::make_unique<unpacked_stream>(it->second->Provider);
-	if (const auto it = m_fullEntries.find(pathSpec); it != m_fullEntries.end())
-		return std::make_unique<unpacked_stream>(it->second->Provider);
+	if (const auto slot = find_slot(pathSpec); slot != SIZE_MAX)
+		return std::make_unique<unpacked_stream>(m_entries[m_entrySlots[slot].Index].Provider);
 	throw std::out_of_range(std::format("path_spec({}) not found", pathSpec));
 }
 
 std::vector<xivres::path_spec> xivres::sqpack::generator::all_path_spec() const {
 	std::vector<path_spec> res;
-	res.reserve(m_hashOnlyEntries.size() + m_fullEntries.size());
-	for (const auto& entry : m_hashOnlyEntries | std::views::keys)
-		res.emplace_back(entry);
-	for (const auto& entry : m_fullEntries | std::views::keys)
-		res.emplace_back(entry);
+	res.reserve(m_entryCount);
+	for (const auto& entry : m_entries) {
+		if (entry.Provider)
+			res.emplace_back(entry.Provider->path_spec());
+	}
 	return res;
 }
@@ -0,0 +1,360 @@
+#include "../include/xivres/sqpack.updater.h"
+
+#include <fstream>
+#include <set>
+
+// Writes to a temporary file first and then renames it over, so that the file is either replaced as a whole or left as it was.
+static void replace_file(const std::filesystem::path& path, std::span<const uint8_t> data) {
+	auto tempPath = path;
+	tempPath += ".tmp";
+
+	std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	out.close();
+	if (!out) {
+		std::error_code ec;
+		std::filesystem::remove(tempPath, ec);
+		throw std::runtime_error("Failed to write to index file.");
+	}
+
+	std::filesystem::rename(tempPath, path);
+}
+
+xivres::sqpack::updater::updater(std::filesystem::path indexPath, uint64_t maxFileSize)
+	: m_indexPath(std::move(indexPath))
+	, m_maxFileSize(maxFileSize) {
+	if (maxFileSize > sqdata::header::MaxFileSize_MaxValue)
+		throw std::invalid_argument("MaxFileSize cannot be more than 32GiB.");
+
+	load();
+}
+
+void xivres::sqpack::updater::load() {
+	m_hashOnlyEntries.clear();
+	m_fullEntries.clear();
+	m_removed.clear();
+	m_reader.reset();
+
+	finish_compaction();
+	m_reader.emplace(reader::from_path(m_indexPath));
+	for (const auto& entry : m_reader->Entries) {
+		auto info = std::make_unique<entry_info>(entry.PathSpec, entry.Locator, &entry);
+		if (entry.PathSpec.has_original())
+			m_fullEntries.emplace(entry.PathSpec, std::move(info));
+		else
+			m_hashOnlyEntries.emplace(entry.PathSpec, std::move(info));
+	}
+}
+
+void xivres::sqpack::updater::add(std::shared_ptr<packed_stream> provider) {
+	const auto& pathSpec = provider->path_spec();
+
+	entry_info* pEntry = nullptr;
+	if (const auto it = m_hashOnlyEntries.find(pathSpec); it != m_hashOnlyEntries.end()) {
+		pEntry = it->second.get();
+		if (!pEntry->PathSpec.has_original() && pathSpec.has_original()) {
+			pEntry->PathSpec = pathSpec;
+			m_fullEntries.emplace(pathSpec, std::move(it->second));
+			m_hashOnlyEntries.erase(it);
+		}
+	} else if (const auto it = m_fullEntries.find(pathSpec); it != m_fullEntries.end()) {
+		pEntry = it->second.get();
+	} else {
+		auto entry = std::make_unique<entry_info>(pathSpec);
+		pEntry = entry.get();
+		if (pathSpec.has_original())
+			m_fullEntries.emplace(pathSpec, std::move(entry));
+		else
+			m_hashOnlyEntries.emplace(pathSpec, std::move(entry));
+	}
+
+	pEntry->Provider = std::move(provider);
+
+	// Adding back a removed path undoes the removal.
+	std::erase(m_removed, pathSpec);
+}
+
+bool xivres::sqpack::updater::remove(const path_spec& pathSpec) {
+	if (const auto it = m_hashOnlyEntries.find(pathSpec); it != m_hashOnlyEntries.end()) {
+		m_hashOnlyEntries.erase(it);
+	} else if (const auto it = m_fullEntries.find(pathSpec); it != m_fullEntries.end()) {
+		m_fullEntries.erase(it);
+	} else
+		return false;
+
+	m_removed.emplace_back(pathSpec);
+	return true;
+}
+
+uint64_t xivres::sqpack::updater::unreferenced_bytes() const {
+	uint64_t total = 0;
+	for (const auto& data : m_reader->Data)
+		total += data.DataHeader.DataSize;
+
+	// Multiple entries may point to the same data; count each stored copy once.
+	std::set<uint32_t> seenLocators;
+	uint64_t referenced = 0;
+	for (const auto entry : all_entries()) {
+		if (!entry->Existing || entry->Provider)
+			continue;
+		if (!seenLocators.insert(entry->Locator.Value).second)
+			continue;
+		referenced += align<uint64_t>(m_reader->packed_at(*entry->Existing)->size()).Alloc;
+	}
+
+	return total > referenced ? total - referenced : 0;
+}
+
+xivres::sqpack::updater::update_result xivres::sqpack::updater::commit(bool strict, uint64_t compactionThreshold) {
+	update_result res{};
+	res.RemovedEntryCount = m_removed.size();
+
+	const auto entries = all_entries();
+	std::vector<entry_info*> pending;
+	for (const auto entry : entries) {
+		if (entry->Provider)
+			pending.emplace_back(entry);
+	}
+
+	if (compactionThreshold != UINT64_MAX) {
+		res.UnreferencedBytes = unreferenced_bytes();
+		if (res.UnreferencedBytes > compactionThreshold) {
+			compact(strict);
+			res.AppendedEntryCount = pending.size();
+			res.UnreferencedBytes = 0;
+			res.Compacted = true;
+			load();
+			return res;
+		}
+	}
+
+	header dataHeader{};
+	if (m_reader->Data.empty()) {
+		memcpy(dataHeader.Signature, header::Signature_Value, sizeof(header::Signature_Value));
+		dataHeader.HeaderSize = sizeof header;
+		dataHeader.Unknown1 = header::Unknown1_Value;
+		dataHeader.Type = file_type::SqData;
+		dataHeader.Unknown2 = header::Unknown2_Value;
+		if (strict)
+			dataHeader.Sha1.set_from_span(reinterpret_cast<char*>(&dataHeader), offsetof(sqpack::header, Sha1));
+	} else
+		dataHeader = m_reader->Data.front().Header;
+
+	std::vector<sqdata::header> dataSubheaders;
+	for (const auto& data : m_reader->Data)
+		dataSubheaders.emplace_back(data.DataHeader);
+	const auto existingDataCount = dataSubheaders.size();
+
+	const std::vector<sqindex::segment_3_entry> index1Segment3(m_reader->Index1.segment_3().begin(), m_reader->Index1.segment_3().end());
+	const std::vector<sqindex::segment_3_entry> index2Segment3(m_reader->Index2.segment_3().begin(), m_reader->Index2.segment_3().end());
+
+	// The reader keeps the data files open for reading only, which would prevent appending to them.
+	m_reader.reset();
+
+	try {
+		std::fstream dataFile;
+		util::hash_sha1 sha1;
+
+		// Existing data files that have SHA-1 keep having them, even if this commit is not strict.
+		auto hashData = strict;
+
+		const auto finish_data_file = [&] {
+			if (!dataFile.is_open())
+				return;
+
+			auto& subheader = dataSubheaders.back();
+			if (hashData) {
+				sha1.get_digest_bytes(subheader.DataSha1.Value);
+				subheader.Sha1.set_from_span(reinterpret_cast<char*>(&subheader), offsetof(sqdata::header, Sha1));
+			} else {
+				subheader.DataSha1 = {};
+				subheader.Sha1 = {};
+			}
+
+			dataFile.seekp(0, std::ios::beg);
+			dataFile.write(reinterpret_cast<const char*>(&dataHeader), sizeof dataHeader);
+			dataFile.write(reinterpret_cast<const char*>(&subheader), sizeof subheader);
+			if (!dataFile)
+				throw std::runtime_error("Failed to write to output data file.");
+			dataFile.close();
+		};
+
+		// Reads finish in any order, but entries are appended in the order of pending, so that the layout does not depend on timing.
+		util::thread_pool::task_waiter<std::pair<size_t, std::vector<char>>> waiter;
+		std::map<size_t, std::vector<char>> readAhead;
+		for (size_t i = 0, nextAppendIndex = 0; nextAppendIndex < pending.size(); ++nextAppendIndex) {
+			for (; i < pending.size() && waiter.pending() + readAhead.size() < (std::max<size_t>)(8, 2 * waiter.pool().concurrency()); ++i) {
+				waiter.submit([i, entry = pending[i]](util::thread_pool::base_task& task) {
+					task.throw_if_cancelled();
+					return std::make_pair(i, entry->Provider->read_vector<char>());
+				});
+			}
+
+			while (!readAhead.contains(nextAppendIndex)) {
+				auto result = waiter.get();
+				if (!result)
+					throw std::logic_error("Read of an entry was not scheduled");
+				readAhead.emplace(result->first, std::move(result->second));
+			}
+
+			const auto it = readAhead.find(nextAppendIndex);
+			const auto data = std::move(it->second);
+			readAhead.erase(it);
+
+			auto& entry = *pending[nextAppendIndex];
+			const auto entrySize = align<uint64_t>(data.size());
+
+			const auto fits = [&] {
+				return sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize + entrySize.Alloc <= dataSubheaders.back().MaxFileSize;
+			};
+
+			if (!dataFile.is_open() && !dataSubheaders.empty() && dataSubheaders.size() == existingDataCount && fits()) {
+				dataFile.open(data_path(dataSubheaders.size() - 1), std::ios::binary | std::ios::in | std::ios::out);
+				if (!dataFile)
+					throw std::runtime_error("Failed to open data file for appending.");
+
+				// SHA-1 cannot be resumed from a digest, so the existing data has to be hashed again.
+				sha1.reset();
+				hashData = strict || dataSubheaders.back().DataSha1 != sha1_value{} || dataSubheaders.back().Sha1 != sha1_value{};
+				if (hashData) {
+					std::vector<char> buf(65536);
+					dataFile.seekg(sizeof header + sizeof(sqdata::header), std::ios::beg);
+					align<uint64_t>(dataSubheaders.back().DataSize, buf.size()).iterate_chunks([&](uint64_t, uint64_t, uint64_t size) {
+						dataFile.read(&buf[0], static_cast<std::streamsize>(size));
+						if (!dataFile)
+							throw std::runtime_error("Failed to read from data file.");
+						sha1.process_bytes(&buf[0], static_cast<size_t>(size));
+					});
+				}
+
+			} else if (!dataFile.is_open() || !fits()) {
+				finish_data_file();
+				if (dataSubheaders.size() >= 8)
+					throw std::runtime_error("Cannot use more than 8 data files.");
+
+				dataFile.open(data_path(dataSubheaders.size()), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+				if (!dataFile)
+					throw std::runtime_error("Failed to create data file.");
+
+				dataSubheaders.emplace_back(sqdata::header{
+					.HeaderSize = sizeof(sqdata::header),
+					.Unknown1 = sqdata::header::Unknown1_Value,
+					.DataSize = 0,
+					.SpanIndex = static_cast<uint32_t>(dataSubheaders.size()),
+					.MaxFileSize = m_maxFileSize,
+				});
+				sha1.reset();
+				hashData = strict;
+			}
+
+			entry.Locator = {static_cast<uint32_t>(dataSubheaders.size() - 1), sizeof header + sizeof(sqdata::header) + dataSubheaders.back().DataSize};
+			dataFile.seekp(static_cast<std::streamoff>(entry.Locator.offset()), std::ios::beg);
+			dataFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+			if (entrySize.Pad) {
+				static constexpr char Padding[EntryAlignment]{};
+				dataFile.write(Padding, static_cast<std::streamsize>(entrySize.Pad));
+				if (hashData)
+					sha1.process_bytes(data.data(), data.size()).process_bytes(Padding, static_cast<size_t>(entrySize.Pad));
+			} else if (hashData)
+				sha1.process_bytes(data.data(), data.size());
+			if (!dataFile)
+				throw std::runtime_error("Failed to write to output data file.");
+
+			dataSubheaders.back().DataSize = dataSubheaders.back().DataSize + entrySize.Alloc;
+			res.AppendedEntryCount++;
+			res.AppendedBytes += entrySize.Alloc;
+		}
+
+		finish_data_file();
+
+		// Index files go last, so that the sqpack stays valid in its previous state should anything above fail.
+		std::vector<std::pair<path_spec, sqindex::data_locator>> indexEntries;
+		indexEntries.reserve(entries.size());
+		for (const auto entry : entries)
+			indexEntries.emplace_back(entry->PathSpec, entry->Locator);
+
+		const auto [index1, index2] = generator::export_index_files_data(indexEntries, dataSubheaders.size(), index1Segment3, index2Segment3, strict);
+		replace_file(std::filesystem::path(m_indexPath).replace_extension(".index2"), index2);
+		replace_file(std::filesystem::path(m_indexPath).replace_extension(".index"), index1);
+	} catch (...) {
+		load();
+		throw;
+	}
+
+	load();
+	return res;
+}
+
+void xivres::sqpack::updater::compact(bool strict) {
+	const auto datName = dat_name();
+	const auto tempDir = std::filesystem::path(m_indexPath).replace_filename(std::format("{}.compact", datName));
+	remove_all(tempDir);
+	create_directories(tempDir);
+
+	{
+		generator gen(m_indexPath.parent_path().filename().string(), datName, m_maxFileSize);
+		// Entries of the original sqpack may already be sharing their data.
+		gen.set_deduplicate(true);
+		gen.add_sqpack(*m_reader, true, true);
+		for (const auto& pathSpec : m_removed)
+			gen.remove(pathSpec);
+		for (const auto entry : all_entries()) {
+			if (entry->Provider)
+				gen.add(entry->Provider);
+		}
+		gen.export_to_files(tempDir, strict);
+	}
+
+	m_reader.reset();
+
+	// Renaming the directory commits the compaction; should anything after this fail, the next load finishes it.
+	std::filesystem::rename(tempDir, compacted_dir());
+	finish_compaction();
+}
+
+void xivres::sqpack::updater::finish_compaction() const {
+	const auto datName = dat_name();
+	const auto compactedDir = compacted_dir();
+	if (!exists(compactedDir))
+		return;
+
+	// Index files get moved last, and are what tells how many data files there are, so this can be resumed from any point.
+	if (const auto compactedIndex = compactedDir / std::format("{}.win32.index", datName); exists(compactedIndex)) {
+		const auto dataFileCount = reader::sqindex_1_type(file_stream(compactedIndex), false).index_header().TextLocatorSegment.Count;
+		for (size_t i = 0; i < 8; ++i) {
+			if (i >= dataFileCount)
+				std::filesystem::remove(data_path(i));
+			else if (const auto compacted = compactedDir / std::format("{}.win32.dat{}", datName, i); exists(compacted))
+				std::filesystem::rename(compacted, data_path(i));
+		}
+
+		if (const auto compactedIndex2 = compactedDir / std::format("{}.win32.index2", datName); exists(compactedIndex2))
+			std::filesystem::rename(compactedIndex2, std::filesystem::path(m_indexPath).replace_extension(".index2"));
+		std::filesystem::rename(compactedIndex, std::filesystem::path(m_indexPath).replace_extension(".index"));
+	}
+
+	std::filesystem::remove_all(compactedDir);
+}
+
+std::vector<xivres::sqpack::updater::entry_info*> xivres::sqpack::updater::all_entries() const {
+	std::vector<entry_info*> res;
+	res.reserve(m_hashOnlyEntries.size() + m_fullEntries.size());
+	for (const auto& entry : m_hashOnlyEntries | std::views::values)
+		res.emplace_back(entry.get());
+	for (const auto& entry : m_fullEntries | std::views::values)
+		res.emplace_back(entry.get());
+	return res;
+}
+
+std::string xivres::sqpack::updater::dat_name() const {
+	const auto fileName = m_indexPath.filename().string();
+	return fileName.substr(0, fileName.find('.'));
+}
+
+std::filesystem::path xivres::sqpack::updater::compacted_dir() const {
+	return std::filesystem::path(m_indexPath).replace_filename(std::format("{}.compacted", dat_name()));
+}
+
+std::filesystem::path xivres::sqpack::updater::data_path(size_t index) const {
+	return std::filesystem::path(m_indexPath).replace_extension(std::format(".dat{}", index));
+}
@@ -1,6 +1,9 @@
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include "../include/xivres/stream.h"
@@ -183,7 +186,107 @@ xivres::file_stream::file_stream(std::filesystem::path path)
 }
 
 std::streamsize xivres::file_stream::size() const { return m_data->size(); }
-std::streamsize xivres::file_stream::read(std::streamoff offset, void* buf, std::streamsize length) const { return m_data->read(offset, buf, length); }
+std::streamsize xivres::file_stream::read(std::streamoff offset, void* buf, std::streamsize length) const {
+	return util::thread_pool::lane::io().run([&] { return m_data->read(offset, buf, length); });
+}
+
+#ifdef _WIN32
+struct xivres::positional_file_writer::data {
+	const std::filesystem::path m_path;
+	const HANDLE m_hFile;
+	mutable util::thread_pool::object_pool<std::shared_ptr<void>> m_hDummyEvents;
+
+	data(std::filesystem::path path)
+		: m_path(std::move(path))
+		, m_hFile(CreateFileW(m_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)) {
+		if (m_hFile == INVALID_HANDLE_VALUE)
+			throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()));
+	}
+
+	data(data&&) = delete;
+	data(const data&) = delete;
+	data& operator=(data&&) = delete;
+	data& operator=(const data&) = delete;
+
+	~data() {
+		CloseHandle(m_hFile);
+	}
+
+	void write(uint64_t offset, const void* buf, size_t length) const {
+		constexpr size_t ChunkSize = 0x10000000;
+		for (size_t i = 0; i < length; i += ChunkSize) {
+			const auto toWrite = static_cast<DWORD>((std::min)(ChunkSize, length - i));
+
+			auto hDummyEvent = *m_hDummyEvents;
+			if (!hDummyEvent) {
+				const auto handle = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+				if (handle == nullptr)
+					throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()));
+				hDummyEvent.emplace(handle, [](HANDLE h) { CloseHandle(h); });
+			}
+			DWORD written = 0;
+			OVERLAPPED ov{};
+			ov.hEvent = hDummyEvent->get();
+			ov.Offset = static_cast<DWORD>(offset + i);
+			ov.OffsetHigh = static_cast<DWORD>((offset + i) >> 32);
+			if (!WriteFile(m_hFile, static_cast<const char*>(buf) + i, toWrite, &written, &ov))
+				throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()));
+			if (written != toWrite)
+				throw std::runtime_error("Failed to write all of the requested data.");
+		}
+	}
+};
+
+#else
+
+struct xivres::positional_file_writer::data {
+	const std::filesystem::path m_path;
+	const int m_fd;
+
+	data(std::filesystem::path path)
+		: m_path(std::move(path))
+		, m_fd(open(m_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+		if (m_fd == -1)
+			throw std::system_error(std::error_code(errno, std::generic_category()));
+	}
+
+	data(data&&) = delete;
+	data(const data&) = delete;
+	data& operator=(data&&) = delete;
+	data& operator=(const data&) = delete;
+
+	~data() {
+		close(m_fd);
+	}
+
+	void write(uint64_t offset, const void* buf, size_t length) const {
+		for (size_t i = 0; i < length;) {
+			const auto written = pwrite(m_fd, static_cast<const char*>(buf) + i, length - i, static_cast<off_t>(offset + i));
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				throw std::system_error(std::error_code(errno, std::generic_category()));
+			}
+			if (written == 0)
+				throw std::runtime_error("Failed to write all of the requested data.");
+			i += static_cast<size_t>(written);
+		}
+	}
+};
+
+#endif
+
+xivres::positional_file_writer::positional_file_writer(positional_file_writer&&) noexcept = default;
+xivres::positional_file_writer& xivres::positional_file_writer::operator=(positional_file_writer&&) noexcept = default;
+xivres::positional_file_writer::~positional_file_writer() = default;
+
+xivres::positional_file_writer::positional_file_writer(std::filesystem::path path)
+	: m_data(std::make_unique<data>(std::move(path))) {
+}
+
+void xivres::positional_file_writer::write(uint64_t offset, const void* buf, size_t length) const {
+	util::thread_pool::lane::io().run([&] { m_data->write(offset, buf, length); });
+}
 
 xivres::memory_stream& xivres::memory_stream::operator=(const memory_stream& r) {
 	if (r.owns_data()) {
@@ -29,6 +29,7 @@ size_t xivres::texture::calc_raw_data_length(format_type type, size_t width, siz
 			return width * height * depth * 16;
 
 		case formats::BC1:
+		case formats::BC4:
 			return depth * (std::max<size_t>)(1, ((width + 3) / 4)) * (std::max<size_t>)(1, ((height + 3) / 4)) * 8;
 
 		case formats::BC2:
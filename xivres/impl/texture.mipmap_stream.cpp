@@ -170,62 +170,44 @@ std::shared_ptr<xivres::texture::memory_mipmap_stream> xivres::texture::memory_m
 		}
 
 		case formats::DXT1:
-		{
-			if (cbSource * 2 < pixelCount)
-				throw std::runtime_error("Truncated data detected");
-			while (const auto len = static_cast<uint32_t>((std::min<uint64_t>)(cbSource - read, sizeof buf8))) {
-				strm.read_fully(read, buf8, len);
-				read += len;
-				for (size_t i = 0, count = len; i < count; i += 8, pos += 8) {
-					DecompressBlockDXT1(
-						pos / 2 % strm.Width,
-						pos / 2 / strm.Width * 4,
-						strm.Width, &buf8[i], &b8g8r8a8view[0]);
-				}
-			}
-			break;
-		}
-
 		case formats::DXT3:
-		{
-			if (cbSource * 4 < pixelCount)
-				throw std::runtime_error("Truncated data detected");
-			while (const auto len = static_cast<uint32_t>((std::min<uint64_t>)(cbSource - read, sizeof buf8))) {
-				strm.read_fully(read, buf8, len);
-				read += len;
-				for (size_t i = 0, count = len; i < count; i += 16, pos += 16) {
-					DecompressBlockDXT1(
-						pos / 4 % strm.Width,
-						pos / 4 / strm.Width * 4,
-						strm.Width, &buf8[i], &b8g8r8a8view[0]);
-					for (size_t dy = 0; dy < 4; dy += 1) {
-						for (size_t dx = 0; dx < 4; dx += 2) {
-							auto& native1 = b8g8r8a8view[dy * strm.Width + dx];
-							native1 = util::b8g8r8a8(native1.R, native1.G, native1.B, 17 * (buf8[i + dy * 2 + dx / 2] & 0xF));
-
-							auto& native2 = b8g8r8a8view[dy * strm.Width + dx + 1];
-							native2 = util::b8g8r8a8(native2.R, native2.G, native2.B, 17 * (buf8[i + dy * 2 + dx / 2] >> 4));
-						}
-					}
-				}
-			}
-			break;
-		}
-
 		case formats::DXT5:
+		case formats::BC4:
+		case formats::BC5:
+		case formats::BC7:
 		{
-			if (cbSource * 4 < pixelCount)
+			if (cbSource * (strm.Type == formats::DXT1 || strm.Type == formats::BC4 ? 2 : 4) < pixelCount)
 				throw std::runtime_error("Truncated data detected");
-			while (const auto len = static_cast<uint32_t>((std::min<uint64_t>)(cbSource - read, sizeof buf8))) {
-				strm.read_fully(read, buf8, len);
-				read += len;
-				for (size_t i = 0, count = len; i < count; i += 16, pos += 16) {
-					DecompressBlockDXT5(
-						pos / 4 % strm.Width,
-						pos / 4 / strm.Width * 4,
-						strm.Width, &buf8[i], &b8g8r8a8view[0]);
-				}
+
+			// Whole slices go to the image decoders, which decode many blocks at once and stay inside the image.
+			const auto depth = (std::max<size_t>)(1, strm.Depth);
+			const auto cbSlice = calc_raw_data_length(strm.Type, strm.Width, strm.Height, 1);
+			std::vector<uint8_t> blocks(cbSlice * depth);
+			strm.read_fully(0, blocks.data(), static_cast<std::streamsize>(cbSource));
+
+			decltype(&util::BlockDecompressImageDXT1) decode;
+			switch (strm.Type) {
+				case formats::DXT1:
+					decode = &util::BlockDecompressImageDXT1;
+					break;
+				case formats::DXT3:
+					decode = &util::BlockDecompressImageDXT3;
+					break;
+				case formats::DXT5:
+					decode = &util::BlockDecompressImageDXT5;
+					break;
+				case formats::BC4:
+					decode = &util::BlockDecompressImageBC4;
+					break;
+				case formats::BC5:
+					decode = &util::BlockDecompressImageBC5;
+					break;
+				default:
+					decode = &util::BlockDecompressImageBC7;
+					break;
 			}
+			for (size_t i = 0; i < depth; ++i)
+				decode(strm.Width, strm.Height, &blocks[i * cbSlice], &b8g8r8a8view[i * strm.Width * strm.Height]);
 			break;
 		}
 
@@ -72,7 +72,9 @@ bool xivres::base_unpacker::block_decoder::forward_sqblock(std::span<const uint8
 		return forward_copy(data.subspan(sizeof blockHeader, blockHeader.DecompressedSize));
 
 	const auto target = m_remaining.subspan(0, (std::min)(m_remaining.size_bytes(), static_cast<size_t>(blockHeader.DecompressedSize - m_skipLength)));
-	if (m_bMultithreaded)
+	if (m_pDeferredBlocks)
+		m_pDeferredBlocks->emplace_back(data, target, m_skipLength);
+	else if (m_bMultithreaded)
 		m_waiter.submit([this, target, data, skip = m_skipLength](auto&) { decode_block_to(data, target, skip); });
 	else
 		decode_block_to(data, target, m_skipLength);
@@ -80,7 +82,7 @@ bool xivres::base_unpacker::block_decoder::forward_sqblock(std::span<const uint8
 	return skip(m_skipLength + target.size_bytes(), true);
 }
 
-void xivres::base_unpacker::block_decoder::decode_block_to(std::span<const uint8_t> data, std::span<uint8_t> target, size_t skip) const {
+void xivres::base_unpacker::block_decoder::decode_block_to(std::span<const uint8_t> data, std::span<uint8_t> target, size_t skip) {
 	const auto& blockHeader = *reinterpret_cast<const packed::block_header*>(&data[0]);
 	auto inflater = util::zlib_inflater::pooled();
 	if (!inflater || !inflater->is(-MAX_WBITS))
@@ -99,6 +101,11 @@ void xivres::base_unpacker::block_decoder::decode_block_to(std::span<const uint8
 	}
 }
 
+xivres::util::thread_pool::co_task<> xivres::base_unpacker::block_decoder::decode_block_async(deferred_block block) {
+	decode_block_to(block.Data, block.Target, block.Skip);
+	co_return;
+}
+
 std::unique_ptr<xivres::base_unpacker> xivres::base_unpacker::make_unique(std::shared_ptr<const packed_stream> strm, std::span<uint8_t> obfuscatedHeaderRewrite) {
 	const auto hdr = strm->read_fully<packed::file_header>(0);
 	return make_unique(hdr, std::move(strm), obfuscatedHeaderRewrite);
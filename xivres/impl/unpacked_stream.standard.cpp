@@ -39,7 +39,7 @@ std::streamsize xivres::standard_unpacker::read(std::streamoff offset, void* buf
 		pooledPreload.emplace();
 	auto& preload = *pooledPreload;
 	preload.resize(preloadTo - preloadFrom);
-	util::thread_pool::pool::current().release_working_status([&] { m_stream->read_fully(preloadFrom, std::span(preload)); });
+	m_stream->read_fully(preloadFrom, std::span(preload));
 
 	for (; it < m_blocks.end(); ++it) {
 		if (info.skip_to(it->RequestOffset))
@@ -51,3 +51,50 @@ std::streamsize xivres::standard_unpacker::read(std::streamoff offset, void* buf
 	info.skip_to(size());
 	return info.filled();
 }
+
+xivres::util::thread_pool::co_task<std::streamsize> xivres::standard_unpacker::read_async(std::streamoff offset, void* buf, std::streamsize length) {
+	if (!length || m_blocks.empty())
+		co_return 0;
+
+	std::vector<block_decoder::deferred_block> deferredBlocks;
+	block_decoder info(*this, buf, length, offset);
+	info.defer_to(&deferredBlocks);
+
+	auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), static_cast<uint32_t>(offset));
+	if (it != m_blocks.begin())
+		--it;
+
+	const auto itEnd = std::upper_bound(it, m_blocks.end(), static_cast<uint32_t>(offset + length));
+
+	const auto preloadFrom = static_cast<std::streamoff>(it->BlockOffset);
+	const auto preloadTo = static_cast<std::streamoff>(itEnd == m_blocks.end() ? m_blocks.back().BlockOffset + m_blocks.back().BlockSize : itEnd->BlockOffset);
+
+	auto pooledPreload = *m_preloads;
+	if (!pooledPreload)
+		pooledPreload.emplace();
+	auto& preload = *pooledPreload;
+	preload.resize(preloadTo - preloadFrom);
+	co_await util::thread_pool::read_fully_async(*m_stream, preloadFrom, std::span(preload));
+
+	for (; it < m_blocks.end(); ++it) {
+		if (info.skip_to(it->RequestOffset))
+			break;
+		if (info.forward_sqblock(std::span(preload).subspan(it->BlockOffset - preloadFrom, it->BlockSize)))
+			break;
+	}
+
+	info.skip_to(size());
+
+	if (deferredBlocks.size() >= MinBlockCountForMultithreadedDecompression) {
+		std::vector<util::thread_pool::co_task<>> decodes;
+		decodes.reserve(deferredBlocks.size());
+		for (const auto& block : deferredBlocks)
+			decodes.emplace_back(block_decoder::decode_block_async(block));
+		co_await util::thread_pool::when_all(std::move(decodes));
+	} else {
+		for (const auto& block : deferredBlocks)
+			block_decoder::decode_block_to(block.Data, block.Target, block.Skip);
+	}
+
+	co_return info.filled();
+}
@@ -56,7 +56,7 @@ std::streamsize xivres::texture_unpacker::read(std::streamoff offset, void* buf,
 		pooledPreload.emplace();
 	auto& preload = *pooledPreload;
 	preload.resize(preloadTo - preloadFrom);
-	util::thread_pool::pool::current().release_working_status([&] { m_stream->read_fully(preloadFrom, std::span(preload)); });
+	m_stream->read_fully(preloadFrom, std::span(preload));
 
 	for (; it != m_blocks.end() && !info.complete(); ++it) {
 		auto it2 = std::upper_bound(it->Subblocks.begin(), it->Subblocks.end(), info.current_offset());
@@ -1,5 +1,25 @@
 #include "../include/xivres/util.dxt.h"
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define XIVRES_DXT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define XIVRES_DXT_TARGET_SSE41
+#define XIVRES_DXT_TARGET_AVX2
+#define XIVRES_DXT_INLINE __forceinline
+#else
+#include <cpuid.h>
+#define XIVRES_DXT_TARGET_SSE41 __attribute__((target("sse4.1,ssse3")))
+#define XIVRES_DXT_TARGET_AVX2 __attribute__((target("avx2,sse4.1,ssse3")))
+#define XIVRES_DXT_INLINE inline __attribute__((always_inline))
+#endif
+#endif
+
 void xivres::util::DecompressBlockDXT1(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image) {
 	uint16_t color0 = *reinterpret_cast<const uint16_t*>(blockStorage);
 	uint16_t color1 = *reinterpret_cast<const uint16_t*>(blockStorage + 2);
@@ -65,15 +85,53 @@ void xivres::util::DecompressBlockDXT1(uint32_t x, uint32_t y, uint32_t width, c
 	}
 }
 
-void xivres::util::BlockDecompressImageDXT1(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
-	uint32_t blockCountX = (width + 3) / 4;
-	uint32_t blockCountY = (height + 3) / 4;
-	uint32_t blockWidth = (width < 4) ? width : 4;
-	uint32_t blockHeight = (height < 4) ? height : 4;
+void xivres::util::DecompressBlockDXT3(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image) {
+	uint16_t color0 = *reinterpret_cast<const uint16_t*>(blockStorage + 8);
+	uint16_t color1 = *reinterpret_cast<const uint16_t*>(blockStorage + 10);
+
+	uint32_t temp;
+
+	temp = (color0 >> 11) * 255 + 16;
+	uint8_t r0 = (uint8_t)((temp / 32 + temp) / 32);
+	temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
+	uint8_t g0 = (uint8_t)((temp / 64 + temp) / 64);
+	temp = (color0 & 0x001F) * 255 + 16;
+	uint8_t b0 = (uint8_t)((temp / 32 + temp) / 32);
+
+	temp = (color1 >> 11) * 255 + 16;
+	uint8_t r1 = (uint8_t)((temp / 32 + temp) / 32);
+	temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
+	uint8_t g1 = (uint8_t)((temp / 64 + temp) / 64);
+	temp = (color1 & 0x001F) * 255 + 16;
+	uint8_t b1 = (uint8_t)((temp / 32 + temp) / 32);
+
+	uint32_t code = *reinterpret_cast<const uint32_t*>(blockStorage + 12);
 
-	for (uint32_t j = 0; j < blockCountY; j++) {
-		for (uint32_t i = 0; i < blockCountX; i++) DecompressBlockDXT1(i * 4, j * 4, width, blockStorage + i * 8, image);
-		blockStorage += blockCountX * 8;
+	for (int j = 0; j < 4; j++) {
+		for (int i = 0; i < 4; i++) {
+			uint8_t finalAlpha = 17 * ((blockStorage[j * 2 + i / 2] >> (4 * (i & 1))) & 0x0F);
+
+			uint8_t colorCode = (code >> 2 * (4 * j + i)) & 0x03;
+
+			b8g8r8a8 finalColor;
+			switch (colorCode) {
+				case 0:
+					finalColor = b8g8r8a8(r0, g0, b0, finalAlpha);
+					break;
+				case 1:
+					finalColor = b8g8r8a8(r1, g1, b1, finalAlpha);
+					break;
+				case 2:
+					finalColor = b8g8r8a8((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, finalAlpha);
+					break;
+				case 3:
+					finalColor = b8g8r8a8((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, finalAlpha);
+					break;
+			}
+
+			if (x + i < width)
+				image[(y + j) * width + (x + i)] = finalColor;
+		}
 	}
 }
 
@@ -162,14 +220,802 @@ void xivres::util::DecompressBlockDXT5(uint32_t x, uint32_t y, uint32_t width, c
 	}
 }
 
-void xivres::util::BlockDecompressImageDXT5(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
-	uint32_t blockCountX = (width + 3) / 4;
-	uint32_t blockCountY = (height + 3) / 4;
-	uint32_t blockWidth = (width < 4) ? width : 4;
-	uint32_t blockHeight = (height < 4) ? height : 4;
+namespace {
+	// Same interpolation as alpha in DecompressBlockDXT5, which BC4 blocks are laid out like.
+	void decode_bc4_values(const uint8_t* blockStorage, uint8_t (&values)[16]) {
+		const uint8_t value0 = blockStorage[0];
+		const uint8_t value1 = blockStorage[1];
+
+		uint64_t codes = 0;
+		for (size_t i = 0; i < 6; ++i)
+			codes |= static_cast<uint64_t>(blockStorage[2 + i]) << (8 * i);
+
+		for (size_t i = 0; i < 16; ++i) {
+			const auto code = static_cast<uint32_t>(codes >> (3 * i) & 7);
+			if (code == 0)
+				values[i] = value0;
+			else if (code == 1)
+				values[i] = value1;
+			else if (value0 > value1)
+				values[i] = static_cast<uint8_t>(((8 - code) * value0 + (code - 1) * value1) / 7);
+			else if (code == 6)
+				values[i] = 0;
+			else if (code == 7)
+				values[i] = 255;
+			else
+				values[i] = static_cast<uint8_t>(((6 - code) * value0 + (code - 1) * value1) / 5);
+		}
+	}
+
+	struct bc7_mode {
+		uint8_t SubsetCount;
+		uint8_t PartitionBits;
+		uint8_t RotationBits;
+		uint8_t IndexSelectionBits;
+		uint8_t ColorBits;
+		uint8_t AlphaBits;
+		uint8_t EndpointPBits;
+		uint8_t SharedPBits;
+		uint8_t IndexBits;
+		uint8_t SecondaryIndexBits;
+	};
+
+	constexpr bc7_mode Bc7Modes[8]{
+		{3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+		{2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+		{3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+		{2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+		{1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+		{1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+		{1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+		{2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+	};
+
+	// Subset of each pixel, 1 bit per pixel starting from the lowest bit.
+	constexpr uint16_t Bc7Partitions2[64]{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+	};
+
+	// Subset of each pixel, 2 bits per pixel starting from the lowest bits.
+	constexpr uint32_t Bc7Partitions3[64]{
+		0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+		0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+		0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+		0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+		0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+		0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+		0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+		0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+	};
+
+	// Anchor pixel of the second subset of 2, and of the second and the third subset of 3; the first subset anchors at pixel 0.
+	constexpr uint8_t Bc7Anchors2[64]{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+	};
+
+	constexpr uint8_t Bc7Anchors3Second[64]{
+		3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+		3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+		8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+		3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+	};
+
+	constexpr uint8_t Bc7Anchors3Third[64]{
+		15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+		15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+		15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+		15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+	};
+
+	constexpr uint8_t Bc7Weights2[4]{0, 21, 43, 64};
+	constexpr uint8_t Bc7Weights3[8]{0, 9, 18, 27, 37, 46, 55, 64};
+	constexpr uint8_t Bc7Weights4[16]{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	constexpr const uint8_t* Bc7Weights[5]{nullptr, nullptr, Bc7Weights2, Bc7Weights3, Bc7Weights4};
+
+	class bc7_bits {
+		uint64_t m_low;
+		uint64_t m_high;
+
+	public:
+		explicit bc7_bits(const uint8_t* block) {
+			std::memcpy(&m_low, block, sizeof m_low);
+			std::memcpy(&m_high, block + 8, sizeof m_high);
+		}
+
+		// Fields are read by offset rather than one after another, so that reads do not wait for each other.
+		[[nodiscard]] uint32_t at(uint32_t offset, uint32_t bitCount) const {
+			const auto shift = offset & 63;
+			const auto fromLow = m_low >> shift | m_high << 1 << (63 - shift);
+			const auto fromHigh = m_high >> shift;
+			return static_cast<uint32_t>((offset < 64 ? fromLow : fromHigh) & ((uint64_t{1} << bitCount) - 1));
+		}
+	};
+
+	// Endpoints and interpolation weights of each pixel of a BC7 block, with channels in R, G, B, A order; the channel
+	// swapped with alpha after interpolation is given by Rotation.
+	struct bc7_pixels {
+		uint8_t Endpoints0[16][4];
+		uint8_t Endpoints1[16][4];
+		uint8_t Weights[16][4];
+		uint32_t Rotation;
+	};
+
+	// Each mode gets its own instance, so that the bit counts from the table are constants.
+	template<uint32_t ModeIndex>
+	void unpack_bc7_mode(const uint8_t* block, bc7_pixels& pixels) {
+		constexpr auto mode = Bc7Modes[ModeIndex];
+		const bc7_bits bits(block);
+		uint32_t offset = ModeIndex + 1;
+		const auto partition = bits.at(offset, mode.PartitionBits);
+		offset += mode.PartitionBits;
+		pixels.Rotation = bits.at(offset, mode.RotationBits);
+		offset += mode.RotationBits;
+		const auto indexSelection = bits.at(offset, mode.IndexSelectionBits);
+		offset += mode.IndexSelectionBits;
+
+		const auto endpointCount = mode.SubsetCount * size_t{2};
+		uint8_t endpoints[6][4];
+		for (size_t channel = 0; channel < 4; ++channel) {
+			const auto channelBits = channel < 3 ? mode.ColorBits : mode.AlphaBits;
+			for (size_t i = 0; i < endpointCount; ++i, offset += channelBits)
+				endpoints[i][channel] = static_cast<uint8_t>(bits.at(offset, channelBits));
+		}
+
+		uint32_t colorBits = mode.ColorBits, alphaBits = mode.AlphaBits;
+		if constexpr (mode.EndpointPBits || mode.SharedPBits) {
+			uint32_t pBits[6];
+			for (size_t i = 0; i < endpointCount; ++i)
+				pBits[i] = mode.EndpointPBits || i % 2 == 0 ? bits.at(offset++, 1) : pBits[i - 1];
+			for (size_t i = 0; i < endpointCount; ++i) {
+				for (size_t channel = 0; channel < 4; ++channel)
+					endpoints[i][channel] = static_cast<uint8_t>(endpoints[i][channel] << 1 | pBits[i]);
+			}
+			++colorBits;
+			if (alphaBits)
+				++alphaBits;
+		}
+
+		for (size_t i = 0; i < endpointCount; ++i) {
+			for (size_t channel = 0; channel < 4; ++channel) {
+				const auto precision = channel < 3 ? colorBits : alphaBits;
+				auto& value = endpoints[i][channel];
+				if (!precision)
+					value = 255;
+				else
+					value = static_cast<uint8_t>(value << (8 - precision) | value >> (2 * precision - 8));
+			}
+		}
+
+		// Anchor pixels of each subset have the highest bit of their index omitted.
+		uint32_t subsets[16]{};
+		uint32_t anchorMask = 1;
+		if constexpr (mode.SubsetCount == 2) {
+			for (size_t i = 0; i < 16; ++i)
+				subsets[i] = Bc7Partitions2[partition] >> i & 1;
+			anchorMask |= 1 << Bc7Anchors2[partition];
+		} else if constexpr (mode.SubsetCount == 3) {
+			for (size_t i = 0; i < 16; ++i)
+				subsets[i] = Bc7Partitions3[partition] >> (2 * i) & 3;
+			anchorMask |= 1 << Bc7Anchors3Second[partition] | 1 << Bc7Anchors3Third[partition];
+		}
+
+		uint32_t indices[16];
+		for (size_t i = 0; i < 16; ++i) {
+			const auto indexBits = mode.IndexBits - (anchorMask >> i & 1);
+			indices[i] = bits.at(offset, indexBits);
+			offset += indexBits;
+		}
+
+		uint32_t secondaryIndices[16];
+		if constexpr (mode.SecondaryIndexBits != 0) {
+			for (size_t i = 0; i < 16; ++i) {
+				const auto indexBits = mode.SecondaryIndexBits - (i == 0 ? 1u : 0u);
+				secondaryIndices[i] = bits.at(offset, indexBits);
+				offset += indexBits;
+			}
+		}
+
+		auto colorIndices = indices, alphaIndices = mode.SecondaryIndexBits ? secondaryIndices : indices;
+		auto colorWeights = Bc7Weights[mode.IndexBits], alphaWeights = Bc7Weights[mode.SecondaryIndexBits ? mode.SecondaryIndexBits : mode.IndexBits];
+		if (indexSelection) {
+			std::swap(colorIndices, alphaIndices);
+			std::swap(colorWeights, alphaWeights);
+		}
+
+		for (size_t i = 0; i < 16; ++i) {
+			std::memcpy(pixels.Endpoints0[i], endpoints[subsets[i] * 2], 4);
+			std::memcpy(pixels.Endpoints1[i], endpoints[subsets[i] * 2 + 1], 4);
+			pixels.Weights[i][0] = pixels.Weights[i][1] = pixels.Weights[i][2] = colorWeights[colorIndices[i]];
+			pixels.Weights[i][3] = alphaWeights[alphaIndices[i]];
+		}
+	}
+
+	void unpack_bc7(const uint8_t* block, bc7_pixels& pixels) {
+		using unpack_fn = void(*)(const uint8_t*, bc7_pixels&);
+		static constexpr unpack_fn UnpackModes[8]{
+			&unpack_bc7_mode<0>, &unpack_bc7_mode<1>, &unpack_bc7_mode<2>, &unpack_bc7_mode<3>,
+			&unpack_bc7_mode<4>, &unpack_bc7_mode<5>, &unpack_bc7_mode<6>, &unpack_bc7_mode<7>,
+		};
+
+		// Blocks without a mode bit decode to transparent black.
+		if (!block[0])
+			std::memset(&pixels, 0, sizeof pixels);
+		else
+			UnpackModes[std::countr_zero(block[0])](block, pixels);
+	}
+}
+
+void xivres::util::DecompressBlockBC4(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image) {
+	uint8_t reds[16];
+	decode_bc4_values(blockStorage, reds);
+
+	for (uint32_t j = 0; j < 4; j++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			if (x + i < width)
+				image[(y + j) * width + (x + i)] = b8g8r8a8(reds[j * 4 + i], 0, 0, 255);
+		}
+	}
+}
+
+void xivres::util::DecompressBlockBC5(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image) {
+	uint8_t reds[16], greens[16];
+	decode_bc4_values(blockStorage, reds);
+	decode_bc4_values(blockStorage + 8, greens);
+
+	for (uint32_t j = 0; j < 4; j++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			if (x + i < width)
+				image[(y + j) * width + (x + i)] = b8g8r8a8(reds[j * 4 + i], greens[j * 4 + i], 0, 255);
+		}
+	}
+}
+
+void xivres::util::DecompressBlockBC7(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image) {
+	bc7_pixels pixels;
+	unpack_bc7(blockStorage, pixels);
+
+	for (uint32_t j = 0; j < 4; j++) {
+		for (uint32_t i = 0; i < 4; i++) {
+			const auto p = j * 4 + i;
+			uint8_t rgba[4];
+			for (size_t channel = 0; channel < 4; ++channel) {
+				const auto weight = pixels.Weights[p][channel];
+				rgba[channel] = static_cast<uint8_t>(((64 - weight) * pixels.Endpoints0[p][channel] + weight * pixels.Endpoints1[p][channel] + 32) >> 6);
+			}
+			if (pixels.Rotation)
+				std::swap(rgba[pixels.Rotation - 1], rgba[3]);
+
+			if (x + i < width)
+				image[(y + j) * width + (x + i)] = b8g8r8a8(rgba[0], rgba[1], rgba[2], rgba[3]);
+		}
+	}
+}
+
+namespace {
+	using xivres::util::b8g8r8a8;
+
+	// Decodes blocks laid side by side into the 4 rows of pixels starting at image, each stride pixels apart.
+	using decode_blocks_fn = void(*)(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride);
+
+	template<size_t BlockSize, void(*DecompressBlock)(uint32_t, uint32_t, uint32_t, const uint8_t*, b8g8r8a8*)>
+	void decode_blocks_portable(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		for (size_t i = 0; i < blockCount; ++i)
+			DecompressBlock(static_cast<uint32_t>(i * 4), 0, static_cast<uint32_t>(stride), blocks + i * BlockSize, image);
+	}
+
+	// Runs a decoder that works on groups of blocks over fewer blocks than a group, through buffers padded to a whole group.
+	template<size_t BlockSize, size_t GroupSize>
+	void decode_partial_group(decode_blocks_fn decode, const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		uint8_t paddedBlocks[BlockSize * GroupSize]{};
+		b8g8r8a8 pixels[GroupSize * 16];
+		std::copy_n(blocks, BlockSize * blockCount, paddedBlocks);
+		decode(paddedBlocks, GroupSize, pixels, GroupSize * 4);
+		for (size_t row = 0; row < 4; ++row)
+			std::copy_n(&pixels[row * GroupSize * 4], blockCount * 4, &image[row * stride]);
+	}
+
+	uint32_t load_u32(const uint8_t* p) {
+		uint32_t value;
+		std::memcpy(&value, p, sizeof value);
+		return value;
+	}
+
+#ifdef XIVRES_DXT_X86
+	struct cpu_features {
+		bool Sse41 = false;
+		bool Avx2 = false;
+	};
+
+	cpu_features detect_cpu_features() {
+		// SSSE3, SSE4.1, OSXSAVE, and AVX from leaf 1, AVX2 from leaf 7, and whether the OS saves YMM registers from XCR0.
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0);
+		const auto maxLeaf = regs[0];
+		__cpuid(regs, 1);
+		const auto ecx1 = static_cast<uint32_t>(regs[2]);
+		uint32_t ebx7 = 0;
+		if (maxLeaf >= 7) {
+			__cpuidex(regs, 7, 0);
+			ebx7 = static_cast<uint32_t>(regs[1]);
+		}
+#else
+		unsigned eax, ebx, ecx, edx;
+		const auto maxLeaf = __get_cpuid_max(0, nullptr);
+		__cpuid(1, eax, ebx, ecx, edx);
+		const auto ecx1 = ecx;
+		uint32_t ebx7 = 0;
+		if (maxLeaf >= 7) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			ebx7 = ebx;
+		}
+#endif
+
+		cpu_features res;
+		res.Sse41 = (ecx1 & (1 << 9)) && (ecx1 & (1 << 19));
+		if (res.Sse41 && (ecx1 & (1 << 27)) && (ecx1 & (1 << 28)) && (ebx7 & (1 << 5))) {
+#ifdef _MSC_VER
+			const auto xcr0 = _xgetbv(0);
+#else
+			uint32_t xcr0, xcr0High;
+			__asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+#endif
+			res.Avx2 = (xcr0 & 6) == 6;
+		}
+		return res;
+	}
+
+	struct shuffle_tables {
+		// Indexed by the byte of 2 bit color codes of a row; picks the 4 pixels of the row out of a palette of 4 colors.
+		alignas(16) uint8_t ColorCodes[256][16]{};
+
+		// Indexed by byte offset of a channel in b8g8r8a8 and by row; moves the values of the 4 pixels of the row, out of all 16
+		// in pixel order, to that channel of each pixel.
+		alignas(16) uint8_t ChannelRows[4][4][16]{};
+
+		// Indexed by BC7 rotation; turns 4 pixels in R, G, B, A order into b8g8r8a8, swapping the rotated channel with alpha.
+		alignas(16) uint8_t Bc7Rotations[4][16]{};
+
+		constexpr shuffle_tables() {
+			for (size_t code = 0; code < 256; ++code) {
+				for (size_t i = 0; i < 16; ++i)
+					ColorCodes[code][i] = static_cast<uint8_t>((code >> (i / 4 * 2) & 3) * 4 + i % 4);
+			}
+			for (size_t channel = 0; channel < 4; ++channel) {
+				for (size_t row = 0; row < 4; ++row) {
+					for (size_t i = 0; i < 16; ++i)
+						ChannelRows[channel][row][i] = static_cast<uint8_t>(i % 4 == channel ? row * 4 + i / 4 : 0x80);
+				}
+			}
+			constexpr uint8_t rotatedOrders[4][4]{{2, 1, 0, 3}, {2, 1, 3, 0}, {2, 3, 0, 1}, {3, 1, 0, 2}};
+			for (size_t rotation = 0; rotation < 4; ++rotation) {
+				for (size_t i = 0; i < 16; ++i)
+					Bc7Rotations[rotation][i] = static_cast<uint8_t>(i / 4 * 4 + rotatedOrders[rotation][i % 4]);
+			}
+		}
+	};
+
+	constexpr shuffle_tables ShuffleTables;
+
+	// Helpers below marked XIVRES_DXT_INLINE are also used by the AVX2 decoders, and get inlined so that they are VEX encoded
+	// there instead of being called as SSE code from AVX code.
+
+	XIVRES_DXT_TARGET_SSE41 XIVRES_DXT_INLINE __m128i color_code_shuffle_sse41(uint32_t codes, size_t row) {
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTables.ColorCodes[codes >> (8 * row) & 0xFF]));
+	}
 
-	for (uint32_t j = 0; j < blockCountY; j++) {
-		for (uint32_t i = 0; i < blockCountX; i++) DecompressBlockDXT5(i * 4, j * 4, width, blockStorage + i * 16, image);
-		blockStorage += blockCountX * 16;
+	XIVRES_DXT_TARGET_SSE41 XIVRES_DXT_INLINE __m128i channel_row_shuffle_sse41(size_t channel, size_t row) {
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTables.ChannelRows[channel][row]));
+	}
+
+	// Same as (value * 255 + bias) / divisor followed by (temp / divisor + temp) / divisor in DecompressBlockDXT1.
+	template<int Bits>
+	XIVRES_DXT_TARGET_SSE41 __m128i expand_channel_sse41(__m128i value) {
+		const auto temp = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(value, 8), value), _mm_set1_epi32(1 << (Bits - 1)));
+		return _mm_srli_epi32(_mm_add_epi32(_mm_srli_epi32(temp, Bits), temp), Bits);
+	}
+
+	// Exact for values up to 3 * 255.
+	XIVRES_DXT_TARGET_SSE41 __m128i div3_sse41(__m128i value) {
+		return _mm_srli_epi32(_mm_mullo_epi32(value, _mm_set1_epi32(0xAAAB)), 17);
+	}
+
+	XIVRES_DXT_TARGET_SSE41 __m128i pack_color_sse41(__m128i r, __m128i g, __m128i b) {
+		return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(g, 8)), b);
+	}
+
+	// Turns the color endpoints of 4 blocks, one per lane, into the palette of each block.
+	// BC1 blocks use 3 colors and black when color0 <= color1, and are opaque; BC2 and BC3 blocks get zero alpha.
+	template<bool Bc1>
+	XIVRES_DXT_TARGET_SSE41 void make_palettes_sse41(__m128i endpoints, __m128i(&palettes)[4]) {
+		const auto mask5 = _mm_set1_epi32(0x1F);
+		const auto mask6 = _mm_set1_epi32(0x3F);
+		const auto c0 = _mm_and_si128(endpoints, _mm_set1_epi32(0xFFFF));
+		const auto c1 = _mm_srli_epi32(endpoints, 16);
+		const auto r0 = expand_channel_sse41<5>(_mm_srli_epi32(c0, 11));
+		const auto g0 = expand_channel_sse41<6>(_mm_and_si128(_mm_srli_epi32(c0, 5), mask6));
+		const auto b0 = expand_channel_sse41<5>(_mm_and_si128(c0, mask5));
+		const auto r1 = expand_channel_sse41<5>(_mm_srli_epi32(c1, 11));
+		const auto g1 = expand_channel_sse41<6>(_mm_and_si128(_mm_srli_epi32(c1, 5), mask6));
+		const auto b1 = expand_channel_sse41<5>(_mm_and_si128(c1, mask5));
+
+		auto p0 = pack_color_sse41(r0, g0, b0);
+		auto p1 = pack_color_sse41(r1, g1, b1);
+		auto p2 = pack_color_sse41(
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(r0, r0), r1)),
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(g0, g0), g1)),
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(b0, b0), b1)));
+		auto p3 = pack_color_sse41(
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(r1, r1), r0)),
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(g1, g1), g0)),
+			div3_sse41(_mm_add_epi32(_mm_add_epi32(b1, b1), b0)));
+		if constexpr (Bc1) {
+			const auto fourColors = _mm_cmpgt_epi32(c0, c1);
+			const auto opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+			const auto halfway = pack_color_sse41(
+				_mm_srli_epi32(_mm_add_epi32(r0, r1), 1),
+				_mm_srli_epi32(_mm_add_epi32(g0, g1), 1),
+				_mm_srli_epi32(_mm_add_epi32(b0, b1), 1));
+			p0 = _mm_or_si128(p0, opaque);
+			p1 = _mm_or_si128(p1, opaque);
+			p2 = _mm_or_si128(_mm_blendv_epi8(halfway, p2, fourColors), opaque);
+			p3 = _mm_or_si128(_mm_and_si128(p3, fourColors), opaque);
+		}
+
+		const auto t0 = _mm_unpacklo_epi32(p0, p1);
+		const auto t1 = _mm_unpacklo_epi32(p2, p3);
+		const auto t2 = _mm_unpackhi_epi32(p0, p1);
+		const auto t3 = _mm_unpackhi_epi32(p2, p3);
+		palettes[0] = _mm_unpacklo_epi64(t0, t1);
+		palettes[1] = _mm_unpackhi_epi64(t0, t1);
+		palettes[2] = _mm_unpacklo_epi64(t2, t3);
+		palettes[3] = _mm_unpackhi_epi64(t2, t3);
+	}
+
+	// Alpha of the 16 pixels of a BC2 block, in pixel order.
+	XIVRES_DXT_TARGET_SSE41 XIVRES_DXT_INLINE __m128i explicit_alphas_sse41(const uint8_t* block) {
+		const auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+		const auto nibbles = _mm_and_si128(_mm_unpacklo_epi8(packed, _mm_srli_epi16(packed, 4)), _mm_set1_epi8(0x0F));
+		return _mm_or_si128(nibbles, _mm_slli_epi16(nibbles, 4));
+	}
+
+	// Values of the 16 pixels of a BC4 block, which is also how BC3 stores alpha, in pixel order.
+	XIVRES_DXT_TARGET_SSE41 XIVRES_DXT_INLINE __m128i interpolated_values_sse41(const uint8_t* block) {
+		const auto a0 = _mm_set1_epi16(block[0]);
+		const auto a1 = _mm_set1_epi16(block[1]);
+
+		// Weighted sums divided by 7 or by 5 with multiplications that are exact for sums up to 7 * 255; codes 6 and 7 are
+		// 0 and 255 when alpha0 <= alpha1.
+		const auto sum8 = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+		const auto sum6 = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)), _mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+		const auto palette8 = _mm_mulhi_epu16(sum8, _mm_set1_epi16(9363));
+		const auto palette6 = _mm_or_si128(_mm_mulhi_epu16(sum6, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+		const auto palette16 = _mm_blendv_epi8(palette6, palette8, _mm_set1_epi16(block[0] > block[1] ? -1 : 0));
+		const auto palette = _mm_packus_epi16(palette16, palette16);
+
+		// Each 3 bit code is taken from the 2 bytes it spans, moved to the top of the 16 bit lane, and then down to the bottom.
+		const auto bits = _mm_srli_si128(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(block)), 2);
+		const auto spans0 = _mm_shuffle_epi8(bits, _mm_setr_epi8(0, 1, 0, 1, 0, 1, 1, 2, 1, 2, 1, 2, 2, 3, 2, 3));
+		const auto spans1 = _mm_shuffle_epi8(bits, _mm_setr_epi8(3, 4, 3, 4, 3, 4, 4, 5, 4, 5, 4, 5, 5, 6, 5, 6));
+		const auto shifts = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+		const auto codes = _mm_packus_epi16(
+			_mm_srli_epi16(_mm_mullo_epi16(spans0, shifts), 13),
+			_mm_srli_epi16(_mm_mullo_epi16(spans1, shifts), 13));
+		return _mm_shuffle_epi8(palette, codes);
+	}
+
+	XIVRES_DXT_TARGET_SSE41 void decode_bc1_blocks_sse41(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		for (; blockCount >= 4; blockCount -= 4, blocks += 4 * 8, image += 4 * 4) {
+			const auto blocks01 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks)));
+			const auto blocks23 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)));
+			__m128i palettes[4];
+			make_palettes_sse41<true>(_mm_castps_si128(_mm_shuffle_ps(blocks01, blocks23, _MM_SHUFFLE(2, 0, 2, 0))), palettes);
+
+			for (size_t i = 0; i < 4; ++i) {
+				const auto codes = load_u32(blocks + i * 8 + 4);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm_shuffle_epi8(palettes[i], color_code_shuffle_sse41(codes, row));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(&image[row * stride + i * 4]), pixels);
+				}
+			}
+		}
+		if (blockCount)
+			decode_partial_group<8, 4>(&decode_bc1_blocks_sse41, blocks, blockCount, image, stride);
+	}
+
+	template<bool InterpolatedAlpha>
+	XIVRES_DXT_TARGET_SSE41 void decode_bc23_blocks_sse41(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		for (; blockCount >= 4; blockCount -= 4, blocks += 4 * 16, image += 4 * 4) {
+			// Color endpoints and codes are the third and fourth dwords of each block.
+			const auto high01 = _mm_unpackhi_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)));
+			const auto high23 = _mm_unpackhi_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 32)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 48)));
+			__m128i palettes[4];
+			make_palettes_sse41<false>(_mm_unpacklo_epi64(high01, high23), palettes);
+
+			for (size_t i = 0; i < 4; ++i) {
+				const auto block = blocks + i * 16;
+				__m128i alphas;
+				if constexpr (InterpolatedAlpha)
+					alphas = interpolated_values_sse41(block);
+				else
+					alphas = explicit_alphas_sse41(block);
+				const auto codes = load_u32(block + 12);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm_or_si128(
+						_mm_shuffle_epi8(palettes[i], color_code_shuffle_sse41(codes, row)),
+						_mm_shuffle_epi8(alphas, channel_row_shuffle_sse41(3, row)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(&image[row * stride + i * 4]), pixels);
+				}
+			}
+		}
+		if (blockCount)
+			decode_partial_group<16, 4>(&decode_bc23_blocks_sse41<InterpolatedAlpha>, blocks, blockCount, image, stride);
+	}
+
+	template<bool TwoChannels>
+	XIVRES_DXT_TARGET_SSE41 void decode_bc45_blocks_sse41(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		const auto opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		for (size_t i = 0; i < blockCount; ++i) {
+			if constexpr (TwoChannels) {
+				const auto reds = interpolated_values_sse41(blocks + i * 16);
+				const auto greens = interpolated_values_sse41(blocks + i * 16 + 8);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm_or_si128(
+						_mm_or_si128(_mm_shuffle_epi8(reds, channel_row_shuffle_sse41(2, row)), _mm_shuffle_epi8(greens, channel_row_shuffle_sse41(1, row))),
+						opaque);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(&image[row * stride + i * 4]), pixels);
+				}
+			} else {
+				const auto reds = interpolated_values_sse41(blocks + i * 8);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm_or_si128(_mm_shuffle_epi8(reds, channel_row_shuffle_sse41(2, row)), opaque);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(&image[row * stride + i * 4]), pixels);
+				}
+			}
+		}
 	}
+
+	// ((64 - weight) * e0 + weight * e1 + 32) / 64, for 8 channels widened to 16 bits.
+	XIVRES_DXT_TARGET_SSE41 __m128i interpolate_bc7_sse41(__m128i endpoint0, __m128i endpoint1, __m128i weight) {
+		const auto weighted0 = _mm_mullo_epi16(endpoint0, _mm_sub_epi16(_mm_set1_epi16(64), weight));
+		const auto weighted1 = _mm_mullo_epi16(endpoint1, weight);
+		return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(weighted0, weighted1), _mm_set1_epi16(32)), 6);
+	}
+
+	// Blocks are unpacked one by one into endpoints and weights for each pixel, and then a row of 4 pixels is interpolated at once.
+	XIVRES_DXT_TARGET_SSE41 void decode_bc7_blocks_sse41(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		bc7_pixels pixels;
+		for (size_t i = 0; i < blockCount; ++i) {
+			unpack_bc7(blocks + i * 16, pixels);
+			const auto toB8g8r8a8 = _mm_load_si128(reinterpret_cast<const __m128i*>(ShuffleTables.Bc7Rotations[pixels.Rotation]));
+			for (size_t row = 0; row < 4; ++row) {
+				const auto endpoints0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels.Endpoints0[row * 4]));
+				const auto endpoints1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels.Endpoints1[row * 4]));
+				const auto weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels.Weights[row * 4]));
+				const auto low = interpolate_bc7_sse41(_mm_cvtepu8_epi16(endpoints0), _mm_cvtepu8_epi16(endpoints1), _mm_cvtepu8_epi16(weights));
+				const auto high = interpolate_bc7_sse41(
+					_mm_cvtepu8_epi16(_mm_srli_si128(endpoints0, 8)),
+					_mm_cvtepu8_epi16(_mm_srli_si128(endpoints1, 8)),
+					_mm_cvtepu8_epi16(_mm_srli_si128(weights, 8)));
+				const auto rgba = _mm_packus_epi16(low, high);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&image[row * stride + i * 4]), _mm_shuffle_epi8(rgba, toB8g8r8a8));
+			}
+		}
+	}
+
+	template<int Bits>
+	XIVRES_DXT_TARGET_AVX2 __m256i expand_channel_avx2(__m256i value) {
+		const auto temp = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(value, 8), value), _mm256_set1_epi32(1 << (Bits - 1)));
+		return _mm256_srli_epi32(_mm256_add_epi32(_mm256_srli_epi32(temp, Bits), temp), Bits);
+	}
+
+	XIVRES_DXT_TARGET_AVX2 __m256i div3_avx2(__m256i value) {
+		return _mm256_srli_epi32(_mm256_mullo_epi32(value, _mm256_set1_epi32(0xAAAB)), 17);
+	}
+
+	XIVRES_DXT_TARGET_AVX2 __m256i pack_color_avx2(__m256i r, __m256i g, __m256i b) {
+		return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8)), b);
+	}
+
+	// Same as make_palettes_sse41 for 8 blocks, with endpoints of blocks 0, 2, 4, 6 in the low half and 1, 3, 5, 7 in the
+	// high half; palettes[i] ends up with the palettes of blocks 2i and 2i + 1, which are next to each other in the image.
+	template<bool Bc1>
+	XIVRES_DXT_TARGET_AVX2 void make_palettes_avx2(__m256i endpoints, __m256i(&palettes)[4]) {
+		const auto mask5 = _mm256_set1_epi32(0x1F);
+		const auto mask6 = _mm256_set1_epi32(0x3F);
+		const auto c0 = _mm256_and_si256(endpoints, _mm256_set1_epi32(0xFFFF));
+		const auto c1 = _mm256_srli_epi32(endpoints, 16);
+		const auto r0 = expand_channel_avx2<5>(_mm256_srli_epi32(c0, 11));
+		const auto g0 = expand_channel_avx2<6>(_mm256_and_si256(_mm256_srli_epi32(c0, 5), mask6));
+		const auto b0 = expand_channel_avx2<5>(_mm256_and_si256(c0, mask5));
+		const auto r1 = expand_channel_avx2<5>(_mm256_srli_epi32(c1, 11));
+		const auto g1 = expand_channel_avx2<6>(_mm256_and_si256(_mm256_srli_epi32(c1, 5), mask6));
+		const auto b1 = expand_channel_avx2<5>(_mm256_and_si256(c1, mask5));
+
+		auto p0 = pack_color_avx2(r0, g0, b0);
+		auto p1 = pack_color_avx2(r1, g1, b1);
+		auto p2 = pack_color_avx2(
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(r0, r0), r1)),
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(g0, g0), g1)),
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(b0, b0), b1)));
+		auto p3 = pack_color_avx2(
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(r1, r1), r0)),
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(g1, g1), g0)),
+			div3_avx2(_mm256_add_epi32(_mm256_add_epi32(b1, b1), b0)));
+		if constexpr (Bc1) {
+			const auto fourColors = _mm256_cmpgt_epi32(c0, c1);
+			const auto opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+			const auto halfway = pack_color_avx2(
+				_mm256_srli_epi32(_mm256_add_epi32(r0, r1), 1),
+				_mm256_srli_epi32(_mm256_add_epi32(g0, g1), 1),
+				_mm256_srli_epi32(_mm256_add_epi32(b0, b1), 1));
+			p0 = _mm256_or_si256(p0, opaque);
+			p1 = _mm256_or_si256(p1, opaque);
+			p2 = _mm256_or_si256(_mm256_blendv_epi8(halfway, p2, fourColors), opaque);
+			p3 = _mm256_or_si256(_mm256_and_si256(p3, fourColors), opaque);
+		}
+
+		const auto t0 = _mm256_unpacklo_epi32(p0, p1);
+		const auto t1 = _mm256_unpacklo_epi32(p2, p3);
+		const auto t2 = _mm256_unpackhi_epi32(p0, p1);
+		const auto t3 = _mm256_unpackhi_epi32(p2, p3);
+		palettes[0] = _mm256_unpacklo_epi64(t0, t1);
+		palettes[1] = _mm256_unpackhi_epi64(t0, t1);
+		palettes[2] = _mm256_unpacklo_epi64(t2, t3);
+		palettes[3] = _mm256_unpackhi_epi64(t2, t3);
+	}
+
+	XIVRES_DXT_TARGET_AVX2 __m256i color_code_shuffle_avx2(uint32_t codesLow, uint32_t codesHigh, size_t row) {
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(color_code_shuffle_sse41(codesLow, row)), color_code_shuffle_sse41(codesHigh, row), 1);
+	}
+
+	XIVRES_DXT_TARGET_AVX2 void decode_bc1_blocks_avx2(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		for (; blockCount >= 8; blockCount -= 8, blocks += 8 * 8, image += 8 * 4) {
+			const auto blocks0123 = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks)));
+			const auto blocks4567 = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + 32)));
+			const auto endpoints = _mm256_permutevar8x32_epi32(
+				_mm256_castps_si256(_mm256_shuffle_ps(blocks0123, blocks4567, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm256_setr_epi32(0, 4, 2, 6, 1, 5, 3, 7));
+			__m256i palettes[4];
+			make_palettes_avx2<true>(endpoints, palettes);
+
+			for (size_t i = 0; i < 4; ++i) {
+				const auto codesLow = load_u32(blocks + i * 16 + 4);
+				const auto codesHigh = load_u32(blocks + i * 16 + 12);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm256_shuffle_epi8(palettes[i], color_code_shuffle_avx2(codesLow, codesHigh, row));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(&image[row * stride + i * 8]), pixels);
+				}
+			}
+		}
+		if (blockCount)
+			decode_partial_group<8, 8>(&decode_bc1_blocks_avx2, blocks, blockCount, image, stride);
+	}
+
+	template<bool InterpolatedAlpha>
+	XIVRES_DXT_TARGET_AVX2 void decode_bc23_blocks_avx2(const uint8_t* blocks, size_t blockCount, b8g8r8a8* image, size_t stride) {
+		for (; blockCount >= 8; blockCount -= 8, blocks += 8 * 16, image += 8 * 4) {
+			const auto high0213 = _mm256_unpackhi_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + 32)));
+			const auto high4657 = _mm256_unpackhi_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + 64)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks + 96)));
+			__m256i palettes[4];
+			make_palettes_avx2<false>(_mm256_unpacklo_epi64(high0213, high4657), palettes);
+
+			for (size_t i = 0; i < 4; ++i) {
+				const auto blockLow = blocks + i * 32;
+				const auto blockHigh = blockLow + 16;
+				__m256i alphas;
+				if constexpr (InterpolatedAlpha)
+					alphas = _mm256_inserti128_si256(_mm256_castsi128_si256(interpolated_values_sse41(blockLow)), interpolated_values_sse41(blockHigh), 1);
+				else
+					alphas = _mm256_inserti128_si256(_mm256_castsi128_si256(explicit_alphas_sse41(blockLow)), explicit_alphas_sse41(blockHigh), 1);
+				const auto codesLow = load_u32(blockLow + 12);
+				const auto codesHigh = load_u32(blockHigh + 12);
+				for (size_t row = 0; row < 4; ++row) {
+					const auto pixels = _mm256_or_si256(
+						_mm256_shuffle_epi8(palettes[i], color_code_shuffle_avx2(codesLow, codesHigh, row)),
+						_mm256_shuffle_epi8(alphas, _mm256_broadcastsi128_si256(channel_row_shuffle_sse41(3, row))));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(&image[row * stride + i * 8]), pixels);
+				}
+			}
+		}
+		if (blockCount)
+			decode_partial_group<16, 8>(&decode_bc23_blocks_avx2<InterpolatedAlpha>, blocks, blockCount, image, stride);
+	}
+#endif
+
+	struct block_decoders {
+		decode_blocks_fn Bc1;
+		decode_blocks_fn Bc2;
+		decode_blocks_fn Bc3;
+		decode_blocks_fn Bc4;
+		decode_blocks_fn Bc5;
+		decode_blocks_fn Bc7;
+	};
+
+	block_decoders select_block_decoders() {
+#ifdef XIVRES_DXT_X86
+		const auto features = detect_cpu_features();
+		// BC4, BC5, and BC7 blocks are decoded one at a time, so AVX2 would not gain anything over SSE4.1 there.
+		if (features.Avx2) {
+			return {
+				&decode_bc1_blocks_avx2, &decode_bc23_blocks_avx2<false>, &decode_bc23_blocks_avx2<true>,
+				&decode_bc45_blocks_sse41<false>, &decode_bc45_blocks_sse41<true>, &decode_bc7_blocks_sse41,
+			};
+		}
+		if (features.Sse41) {
+			return {
+				&decode_bc1_blocks_sse41, &decode_bc23_blocks_sse41<false>, &decode_bc23_blocks_sse41<true>,
+				&decode_bc45_blocks_sse41<false>, &decode_bc45_blocks_sse41<true>, &decode_bc7_blocks_sse41,
+			};
+		}
+#endif
+		return {
+			&decode_blocks_portable<8, &xivres::util::DecompressBlockDXT1>,
+			&decode_blocks_portable<16, &xivres::util::DecompressBlockDXT3>,
+			&decode_blocks_portable<16, &xivres::util::DecompressBlockDXT5>,
+			&decode_blocks_portable<8, &xivres::util::DecompressBlockBC4>,
+			&decode_blocks_portable<16, &xivres::util::DecompressBlockBC5>,
+			&decode_blocks_portable<16, &xivres::util::DecompressBlockBC7>,
+		};
+	}
+
+	const block_decoders& cpu_block_decoders() {
+		static const auto s_decoders = select_block_decoders();
+		return s_decoders;
+	}
+
+	template<size_t BlockSize>
+	void decode_image(decode_blocks_fn decode, uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+		const size_t blockCountX = (width + 3) / 4;
+		const size_t blockCountY = (height + 3) / 4;
+		b8g8r8a8 edge[16];
+		for (size_t by = 0; by < blockCountY; ++by, blockStorage += blockCountX * BlockSize) {
+			const auto rows = (std::min<size_t>)(4, height - by * 4);
+			const auto dst = &image[by * 4 * width];
+
+			// Blocks sticking out of the right or the bottom edge go through a buffer, so that nothing outside the image gets written.
+			size_t bx = 0;
+			if (rows == 4) {
+				bx = width / 4;
+				decode(blockStorage, bx, dst, width);
+			}
+			for (; bx < blockCountX; ++bx) {
+				decode(blockStorage + bx * BlockSize, 1, edge, 4);
+				const auto columns = (std::min<size_t>)(4, width - bx * 4);
+				for (size_t row = 0; row < rows; ++row)
+					std::copy_n(&edge[row * 4], columns, &dst[row * width + bx * 4]);
+			}
+		}
+	}
+}
+
+void xivres::util::BlockDecompressImageDXT1(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<8>(cpu_block_decoders().Bc1, width, height, blockStorage, image);
+}
+
+void xivres::util::BlockDecompressImageDXT3(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<16>(cpu_block_decoders().Bc2, width, height, blockStorage, image);
+}
+
+void xivres::util::BlockDecompressImageDXT5(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<16>(cpu_block_decoders().Bc3, width, height, blockStorage, image);
+}
+
+void xivres::util::BlockDecompressImageBC4(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<8>(cpu_block_decoders().Bc4, width, height, blockStorage, image);
+}
+
+void xivres::util::BlockDecompressImageBC5(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<16>(cpu_block_decoders().Bc5, width, height, blockStorage, image);
+}
+
+void xivres::util::BlockDecompressImageBC7(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image) {
+	decode_image<16>(cpu_block_decoders().Bc7, width, height, blockStorage, image);
 }
@@ -0,0 +1,243 @@
+#include "../include/xivres/util.sha1.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define XIVRES_SHA1_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define XIVRES_SHA1_TARGET_SHANI
+#else
+#include <cpuid.h>
+#define XIVRES_SHA1_TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define XIVRES_SHA1_ARM64
+#include <arm_neon.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#define XIVRES_SHA1_TARGET_ARMV8
+#else
+#define XIVRES_SHA1_TARGET_ARMV8 __attribute__((target("+crypto")))
+#endif
+#endif
+
+namespace {
+	using process_blocks_fn = void(*)(uint32_t* digest, const uint8_t* blocks, size_t blockCount);
+
+	constexpr uint32_t K0 = 0x5A827999;
+	constexpr uint32_t K1 = 0x6ED9EBA1;
+	constexpr uint32_t K2 = 0x8F1BBCDC;
+	constexpr uint32_t K3 = 0xCA62C1D6;
+
+	constexpr uint32_t round_constant(size_t group) {
+		return group < 5 ? K0 : group < 10 ? K1 : group < 15 ? K2 : K3;
+	}
+
+	uint32_t rotl(uint32_t value, int count) {
+		return (value << count) | (value >> (32 - count));
+	}
+
+	uint32_t load_be32(const uint8_t* p) {
+		return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+	}
+
+	void process_blocks_portable(uint32_t* digest, const uint8_t* blocks, size_t blockCount) {
+		uint32_t w[16];
+
+		for (; blockCount; --blockCount, blocks += xivres::util::hash_sha1::BlockSize) {
+			auto a = digest[0], b = digest[1], c = digest[2], d = digest[3], e = digest[4];
+
+			// Message schedule is kept in a 16-word ring; variables are rotated by argument order instead of being moved.
+#define XIVRES_SHA1_W(i) (w[(i) & 15] = rotl(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+#define XIVRES_SHA1_R0(v, w_, x, y, z, i) z += ((w_ & (x ^ y)) ^ y) + (w[i] = load_be32(&blocks[(i) * 4])) + K0 + rotl(v, 5); w_ = rotl(w_, 30)
+#define XIVRES_SHA1_R1(v, w_, x, y, z, i) z += ((w_ & (x ^ y)) ^ y) + XIVRES_SHA1_W(i) + K0 + rotl(v, 5); w_ = rotl(w_, 30)
+#define XIVRES_SHA1_R2(v, w_, x, y, z, i) z += (w_ ^ x ^ y) + XIVRES_SHA1_W(i) + K1 + rotl(v, 5); w_ = rotl(w_, 30)
+#define XIVRES_SHA1_R3(v, w_, x, y, z, i) z += (((w_ | x) & y) | (w_ & x)) + XIVRES_SHA1_W(i) + K2 + rotl(v, 5); w_ = rotl(w_, 30)
+#define XIVRES_SHA1_R4(v, w_, x, y, z, i) z += (w_ ^ x ^ y) + XIVRES_SHA1_W(i) + K3 + rotl(v, 5); w_ = rotl(w_, 30)
+
+			XIVRES_SHA1_R0(a, b, c, d, e, 0); XIVRES_SHA1_R0(e, a, b, c, d, 1); XIVRES_SHA1_R0(d, e, a, b, c, 2); XIVRES_SHA1_R0(c, d, e, a, b, 3);
+			XIVRES_SHA1_R0(b, c, d, e, a, 4); XIVRES_SHA1_R0(a, b, c, d, e, 5); XIVRES_SHA1_R0(e, a, b, c, d, 6); XIVRES_SHA1_R0(d, e, a, b, c, 7);
+			XIVRES_SHA1_R0(c, d, e, a, b, 8); XIVRES_SHA1_R0(b, c, d, e, a, 9); XIVRES_SHA1_R0(a, b, c, d, e, 10); XIVRES_SHA1_R0(e, a, b, c, d, 11);
+			XIVRES_SHA1_R0(d, e, a, b, c, 12); XIVRES_SHA1_R0(c, d, e, a, b, 13); XIVRES_SHA1_R0(b, c, d, e, a, 14); XIVRES_SHA1_R0(a, b, c, d, e, 15);
+			XIVRES_SHA1_R1(e, a, b, c, d, 16); XIVRES_SHA1_R1(d, e, a, b, c, 17); XIVRES_SHA1_R1(c, d, e, a, b, 18); XIVRES_SHA1_R1(b, c, d, e, a, 19);
+			XIVRES_SHA1_R2(a, b, c, d, e, 20); XIVRES_SHA1_R2(e, a, b, c, d, 21); XIVRES_SHA1_R2(d, e, a, b, c, 22); XIVRES_SHA1_R2(c, d, e, a, b, 23);
+			XIVRES_SHA1_R2(b, c, d, e, a, 24); XIVRES_SHA1_R2(a, b, c, d, e, 25); XIVRES_SHA1_R2(e, a, b, c, d, 26); XIVRES_SHA1_R2(d, e, a, b, c, 27);
+			XIVRES_SHA1_R2(c, d, e, a, b, 28); XIVRES_SHA1_R2(b, c, d, e, a, 29); XIVRES_SHA1_R2(a, b, c, d, e, 30); XIVRES_SHA1_R2(e, a, b, c, d, 31);
+			XIVRES_SHA1_R2(d, e, a, b, c, 32); XIVRES_SHA1_R2(c, d, e, a, b, 33); XIVRES_SHA1_R2(b, c, d, e, a, 34); XIVRES_SHA1_R2(a, b, c, d, e, 35);
+			XIVRES_SHA1_R2(e, a, b, c, d, 36); XIVRES_SHA1_R2(d, e, a, b, c, 37); XIVRES_SHA1_R2(c, d, e, a, b, 38); XIVRES_SHA1_R2(b, c, d, e, a, 39);
+			XIVRES_SHA1_R3(a, b, c, d, e, 40); XIVRES_SHA1_R3(e, a, b, c, d, 41); XIVRES_SHA1_R3(d, e, a, b, c, 42); XIVRES_SHA1_R3(c, d, e, a, b, 43);
+			XIVRES_SHA1_R3(b, c, d, e, a, 44); XIVRES_SHA1_R3(a, b, c, d, e, 45); XIVRES_SHA1_R3(e, a, b, c, d, 46); XIVRES_SHA1_R3(d, e, a, b, c, 47);
+			XIVRES_SHA1_R3(c, d, e, a, b, 48); XIVRES_SHA1_R3(b, c, d, e, a, 49); XIVRES_SHA1_R3(a, b, c, d, e, 50); XIVRES_SHA1_R3(e, a, b, c, d, 51);
+			XIVRES_SHA1_R3(d, e, a, b, c, 52); XIVRES_SHA1_R3(c, d, e, a, b, 53); XIVRES_SHA1_R3(b, c, d, e, a, 54); XIVRES_SHA1_R3(a, b, c, d, e, 55);
+			XIVRES_SHA1_R3(e, a, b, c, d, 56); XIVRES_SHA1_R3(d, e, a, b, c, 57); XIVRES_SHA1_R3(c, d, e, a, b, 58); XIVRES_SHA1_R3(b, c, d, e, a, 59);
+			XIVRES_SHA1_R4(a, b, c, d, e, 60); XIVRES_SHA1_R4(e, a, b, c, d, 61); XIVRES_SHA1_R4(d, e, a, b, c, 62); XIVRES_SHA1_R4(c, d, e, a, b, 63);
+			XIVRES_SHA1_R4(b, c, d, e, a, 64); XIVRES_SHA1_R4(a, b, c, d, e, 65); XIVRES_SHA1_R4(e, a, b, c, d, 66); XIVRES_SHA1_R4(d, e, a, b, c, 67);
+			XIVRES_SHA1_R4(c, d, e, a, b, 68); XIVRES_SHA1_R4(b, c, d, e, a, 69); XIVRES_SHA1_R4(a, b, c, d, e, 70); XIVRES_SHA1_R4(e, a, b, c, d, 71);
+			XIVRES_SHA1_R4(d, e, a, b, c, 72); XIVRES_SHA1_R4(c, d, e, a, b, 73); XIVRES_SHA1_R4(b, c, d, e, a, 74); XIVRES_SHA1_R4(a, b, c, d, e, 75);
+			XIVRES_SHA1_R4(e, a, b, c, d, 76); XIVRES_SHA1_R4(d, e, a, b, c, 77); XIVRES_SHA1_R4(c, d, e, a, b, 78); XIVRES_SHA1_R4(b, c, d, e, a, 79);
+
+#undef XIVRES_SHA1_R4
+#undef XIVRES_SHA1_R3
+#undef XIVRES_SHA1_R2
+#undef XIVRES_SHA1_R1
+#undef XIVRES_SHA1_R0
+#undef XIVRES_SHA1_W
+
+			digest[0] += a;
+			digest[1] += b;
+			digest[2] += c;
+			digest[3] += d;
+			digest[4] += e;
+		}
+	}
+
+#ifdef XIVRES_SHA1_X86
+	bool has_sha_ni() {
+		// SSSE3 and SSE4.1 from leaf 1, SHA from leaf 7.
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0);
+		if (regs[0] < 7)
+			return false;
+		__cpuid(regs, 1);
+		const auto ecx1 = static_cast<uint32_t>(regs[2]);
+		__cpuidex(regs, 7, 0);
+		const auto ebx7 = static_cast<uint32_t>(regs[1]);
+#else
+		unsigned eax, ebx, ecx, edx;
+		if (__get_cpuid_max(0, nullptr) < 7)
+			return false;
+		__cpuid(1, eax, ebx, ecx, edx);
+		const auto ecx1 = ecx;
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		const auto ebx7 = ebx;
+#endif
+		return (ecx1 & (1 << 9)) && (ecx1 & (1 << 19)) && (ebx7 & (1 << 29));
+	}
+
+	XIVRES_SHA1_TARGET_SHANI void process_blocks_sha_ni(uint32_t* digest, const uint8_t* blocks, size_t blockCount) {
+		const auto byteSwapMask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+		auto abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digest)), 0x1B);
+		auto e0 = _mm_set_epi32(static_cast<int>(digest[4]), 0, 0, 0);
+
+		for (; blockCount; --blockCount, blocks += xivres::util::hash_sha1::BlockSize) {
+			const auto abcdSaved = abcd;
+			const auto e0Saved = e0;
+			__m128i e1;
+			__m128i msg[4];
+
+			// Each group runs 4 rounds. Group g consumes msg[g % 4], and prepares the message words of groups g + 1 to g + 3.
+#define XIVRES_SHA1_GROUP(g, eCur, eNext) \
+			if constexpr ((g) < 4) \
+				msg[(g) % 4] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * (g))), byteSwapMask); \
+			if constexpr ((g) == 0) \
+				eCur = _mm_add_epi32(eCur, msg[0]); \
+			else \
+				eCur = _mm_sha1nexte_epu32(eCur, msg[(g) % 4]); \
+			eNext = abcd; \
+			if constexpr ((g) >= 3 && (g) <= 18) \
+				msg[((g) + 1) % 4] = _mm_sha1msg2_epu32(msg[((g) + 1) % 4], msg[(g) % 4]); \
+			abcd = _mm_sha1rnds4_epu32(abcd, eCur, (g) / 5); \
+			if constexpr ((g) >= 1 && (g) <= 16) \
+				msg[((g) + 3) % 4] = _mm_sha1msg1_epu32(msg[((g) + 3) % 4], msg[(g) % 4]); \
+			if constexpr ((g) >= 2 && (g) <= 17) \
+				msg[((g) + 2) % 4] = _mm_xor_si128(msg[((g) + 2) % 4], msg[(g) % 4])
+
+			XIVRES_SHA1_GROUP(0, e0, e1); XIVRES_SHA1_GROUP(1, e1, e0); XIVRES_SHA1_GROUP(2, e0, e1); XIVRES_SHA1_GROUP(3, e1, e0);
+			XIVRES_SHA1_GROUP(4, e0, e1); XIVRES_SHA1_GROUP(5, e1, e0); XIVRES_SHA1_GROUP(6, e0, e1); XIVRES_SHA1_GROUP(7, e1, e0);
+			XIVRES_SHA1_GROUP(8, e0, e1); XIVRES_SHA1_GROUP(9, e1, e0); XIVRES_SHA1_GROUP(10, e0, e1); XIVRES_SHA1_GROUP(11, e1, e0);
+			XIVRES_SHA1_GROUP(12, e0, e1); XIVRES_SHA1_GROUP(13, e1, e0); XIVRES_SHA1_GROUP(14, e0, e1); XIVRES_SHA1_GROUP(15, e1, e0);
+			XIVRES_SHA1_GROUP(16, e0, e1); XIVRES_SHA1_GROUP(17, e1, e0); XIVRES_SHA1_GROUP(18, e0, e1); XIVRES_SHA1_GROUP(19, e1, e0);
+
+#undef XIVRES_SHA1_GROUP
+
+			e0 = _mm_sha1nexte_epu32(e0, e0Saved);
+			abcd = _mm_add_epi32(abcd, abcdSaved);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(digest), _mm_shuffle_epi32(abcd, 0x1B));
+		digest[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+	}
+#endif
+
+#ifdef XIVRES_SHA1_ARM64
+	bool has_armv8_sha1() {
+#if defined(_WIN32)
+		return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#elif defined(__linux__)
+		return getauxval(AT_HWCAP) & HWCAP_SHA1;
+#elif defined(__APPLE__)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	XIVRES_SHA1_TARGET_ARMV8 void process_blocks_armv8(uint32_t* digest, const uint8_t* blocks, size_t blockCount) {
+		auto abcd = vld1q_u32(digest);
+		auto e0 = digest[4];
+
+		for (; blockCount; --blockCount, blocks += xivres::util::hash_sha1::BlockSize) {
+			const auto abcdSaved = abcd;
+			const auto e0Saved = e0;
+			uint32_t e1;
+			uint32x4_t msg[4], tmp[2];
+
+			for (size_t i = 0; i < 4; i++)
+				msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16 * i)));
+			tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(K0));
+			tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(K0));
+
+			// Group g consumes tmp[g % 2], which holds msg[g % 4] with the round constant added.
+#define XIVRES_SHA1_GROUP(g, fn, eCur, eNext) \
+			eNext = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+			abcd = fn(abcd, eCur, tmp[(g) % 2]); \
+			if constexpr ((g) >= 1 && (g) <= 16) \
+				msg[((g) + 3) % 4] = vsha1su1q_u32(msg[((g) + 3) % 4], msg[((g) + 2) % 4]); \
+			if constexpr ((g) <= 17) \
+				tmp[(g) % 2] = vaddq_u32(msg[((g) + 2) % 4], vdupq_n_u32(round_constant((g) + 2))); \
+			if constexpr ((g) <= 15) \
+				msg[(g) % 4] = vsha1su0q_u32(msg[(g) % 4], msg[((g) + 1) % 4], msg[((g) + 2) % 4])
+
+			XIVRES_SHA1_GROUP(0, vsha1cq_u32, e0, e1); XIVRES_SHA1_GROUP(1, vsha1cq_u32, e1, e0); XIVRES_SHA1_GROUP(2, vsha1cq_u32, e0, e1); XIVRES_SHA1_GROUP(3, vsha1cq_u32, e1, e0);
+			XIVRES_SHA1_GROUP(4, vsha1cq_u32, e0, e1); XIVRES_SHA1_GROUP(5, vsha1pq_u32, e1, e0); XIVRES_SHA1_GROUP(6, vsha1pq_u32, e0, e1); XIVRES_SHA1_GROUP(7, vsha1pq_u32, e1, e0);
+			XIVRES_SHA1_GROUP(8, vsha1pq_u32, e0, e1); XIVRES_SHA1_GROUP(9, vsha1pq_u32, e1, e0); XIVRES_SHA1_GROUP(10, vsha1mq_u32, e0, e1); XIVRES_SHA1_GROUP(11, vsha1mq_u32, e1, e0);
+			XIVRES_SHA1_GROUP(12, vsha1mq_u32, e0, e1); XIVRES_SHA1_GROUP(13, vsha1mq_u32, e1, e0); XIVRES_SHA1_GROUP(14, vsha1mq_u32, e0, e1); XIVRES_SHA1_GROUP(15, vsha1pq_u32, e1, e0);
+			XIVRES_SHA1_GROUP(16, vsha1pq_u32, e0, e1); XIVRES_SHA1_GROUP(17, vsha1pq_u32, e1, e0); XIVRES_SHA1_GROUP(18, vsha1pq_u32, e0, e1); XIVRES_SHA1_GROUP(19, vsha1pq_u32, e1, e0);
+
+#undef XIVRES_SHA1_GROUP
+
+			e0 += e0Saved;
+			abcd = vaddq_u32(abcd, abcdSaved);
+		}
+
+		vst1q_u32(digest, abcd);
+		digest[4] = e0;
+	}
+#endif
+
+	process_blocks_fn select_process_blocks() {
+#ifdef XIVRES_SHA1_X86
+		if (has_sha_ni())
+			return &process_blocks_sha_ni;
+#endif
+#ifdef XIVRES_SHA1_ARM64
+		if (has_armv8_sha1())
+			return &process_blocks_armv8;
+#endif
+		return &process_blocks_portable;
+	}
+}
+
+void xivres::util::hash_sha1::process_blocks(digest32_t digest, const uint8_t* blocks, size_t blockCount) {
+	static const auto s_fn = select_process_blocks();
+	s_fn(digest, blocks, blockCount);
+}
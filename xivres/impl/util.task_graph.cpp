@@ -0,0 +1,183 @@
+#include "../include/xivres/util.task_graph.h"
+
+xivres::util::thread_pool::task_graph::task_graph(thread_pool::pool& pool)
+	: m_pool(pool) {
+}
+
+xivres::util::thread_pool::task_graph::~task_graph() {
+	cancel();
+
+	std::unique_lock lock(m_mtx);
+	m_pool.release_working_status([&] { m_cv.wait(lock, [this] { return !m_nUnsettledNodes && !m_nScheduledTasks; }); });
+}
+
+xivres::util::thread_pool::task_graph::node_id xivres::util::thread_pool::task_graph::add(std::function<void(base_task&)> fn, std::span<const node_id> dependencies) {
+	const auto lock = std::lock_guard(m_mtx);
+	const auto id = m_nodes.size();
+	for (const auto dependency : dependencies) {
+		if (dependency >= id)
+			throw std::invalid_argument("dependency must be a node added earlier");
+	}
+
+	auto& newNode = m_nodes.emplace_back();
+	newNode.Fn = std::move(fn);
+	m_nUnsettledNodes++;
+
+	auto cancelled = false;
+	for (const auto dependency : dependencies) {
+		auto& dependencyNode = m_nodes[dependency];
+		switch (dependencyNode.State) {
+			case node_state::pending:
+			case node_state::running:
+				dependencyNode.Dependents.emplace_back(id);
+				newNode.RemainingDependencyCount++;
+				break;
+
+			case node_state::finished:
+				break;
+
+			case node_state::failed:
+			case node_state::cancelled:
+				cancelled = true;
+				break;
+		}
+	}
+
+	if (cancelled)
+		cancel_subgraph(id);
+	else if (!newNode.RemainingDependencyCount)
+		schedule(id);
+	return id;
+}
+
+void xivres::util::thread_pool::task_graph::cancel(node_id id) {
+	const auto lock = std::lock_guard(m_mtx);
+	cancel_subgraph(id);
+}
+
+void xivres::util::thread_pool::task_graph::cancel() {
+	const auto lock = std::lock_guard(m_mtx);
+	for (size_t i = 0; i < m_nodes.size(); ++i)
+		cancel_node(i);
+	m_cv.notify_all();
+}
+
+void xivres::util::thread_pool::task_graph::wait() {
+	std::unique_lock lock(m_mtx);
+	m_pool.release_working_status([&] { m_cv.wait(lock, [this] { return !m_nUnsettledNodes && !m_nScheduledTasks; }); });
+	if (m_exception)
+		std::rethrow_exception(m_exception);
+}
+
+xivres::util::thread_pool::task_graph::node_state xivres::util::thread_pool::task_graph::state(node_id id) const {
+	const auto lock = std::lock_guard(m_mtx);
+	return m_nodes.at(id).State;
+}
+
+size_t xivres::util::thread_pool::task_graph::size() const {
+	const auto lock = std::lock_guard(m_mtx);
+	return m_nodes.size();
+}
+
+void xivres::util::thread_pool::task_graph::run_node(node_id id, task<void>& task) {
+	std::function<void(base_task&)> fn;
+	auto runnable = false;
+	{
+		const auto lock = std::lock_guard(m_mtx);
+		auto& node = m_nodes[id];
+		if (node.State == node_state::pending) {
+			node.State = node_state::running;
+			fn = std::move(node.Fn);
+			runnable = true;
+		}
+	}
+
+	// Cancelled before it got to run; it has been settled already.
+	if (!runnable) {
+		const auto lock = std::lock_guard(m_mtx);
+		m_nScheduledTasks--;
+		m_cv.notify_all();
+		return;
+	}
+
+	auto state = node_state::finished;
+	try {
+		if (fn)
+			fn(task);
+		if (task.cancelled())
+			state = node_state::cancelled;
+	} catch (const cancelled_error&) {
+		state = node_state::cancelled;
+	} catch (...) {
+		state = node_state::failed;
+		const auto lock = std::lock_guard(m_mtx);
+		if (!m_exception)
+			m_exception = std::current_exception();
+	}
+	fn = nullptr;
+
+	const auto lock = std::lock_guard(m_mtx);
+	settle(id, state);
+	m_nScheduledTasks--;
+	m_cv.notify_all();
+}
+
+void xivres::util::thread_pool::task_graph::schedule(node_id id) {
+	m_nScheduledTasks++;
+	m_nodes[id].Task = m_pool.submit<void>([this, id](task<void>& task) { run_node(id, task); });
+}
+
+void xivres::util::thread_pool::task_graph::settle(node_id id, node_state state) {
+	auto& node = m_nodes[id];
+	node.State = state;
+	node.Task = nullptr;
+	m_nUnsettledNodes--;
+
+	if (state == node_state::finished) {
+		for (const auto dependent : node.Dependents) {
+			if (auto& dependentNode = m_nodes[dependent]; dependentNode.State == node_state::pending && !--dependentNode.RemainingDependencyCount)
+				schedule(dependent);
+		}
+	} else
+		cancel_subgraph(id);
+}
+
+void xivres::util::thread_pool::task_graph::cancel_subgraph(node_id id) {
+	std::vector<bool> visited(m_nodes.size());
+	std::vector<node_id> stack{id};
+	while (!stack.empty()) {
+		const auto current = stack.back();
+		stack.pop_back();
+		if (visited[current])
+			continue;
+		visited[current] = true;
+
+		cancel_node(current);
+		stack.insert(stack.end(), m_nodes[current].Dependents.begin(), m_nodes[current].Dependents.end());
+	}
+	m_cv.notify_all();
+}
+
+void xivres::util::thread_pool::task_graph::cancel_node(node_id id) {
+	auto& node = m_nodes[id];
+	switch (node.State) {
+		case node_state::pending:
+			// A scheduled task that has not started yet will see the state and return without running.
+			if (node.Task)
+				node.Task->cancel();
+			node.Fn = nullptr;
+			node.State = node_state::cancelled;
+			node.Task = nullptr;
+			m_nUnsettledNodes--;
+			break;
+
+		case node_state::running:
+			node.Task->cancel();
+			break;
+
+		case node_state::finished:
+		case node_state::failed:
+		case node_state::cancelled:
+			break;
+	}
+}
@@ -1,17 +1,36 @@
 #include "../include/xivres/util.thread_pool.h"
 
+namespace {
+	void update_peak(std::atomic_size_t& peak, size_t value) {
+		for (auto prev = peak.load(std::memory_order_relaxed); prev < value && !peak.compare_exchange_weak(prev, value, std::memory_order_relaxed);) {
+			// pass
+		}
+	}
+}
+
+thread_local xivres::util::thread_pool::pool* xivres::util::thread_pool::pool::s_pCurrentPool = nullptr;
+thread_local xivres::util::thread_pool::pool::thread_info* xivres::util::thread_pool::pool::s_pCurrentThreadInfo = nullptr;
+
 xivres::util::thread_pool::pool::pool(size_t nConcurrentExecutions)
 	: m_pmtxThread(std::make_shared<std::shared_mutex>())
 	, m_nConcurrency(nConcurrentExecutions == (std::numeric_limits<size_t>::max)() ? std::thread::hardware_concurrency() : (std::max<size_t>)(1, nConcurrentExecutions))
+	, m_nThreads(0)
+	, m_nActiveThreads(0)
 	, m_nWaitingThreads(0)
 	, m_nFreeThreads(0)
 	, m_bQuitting(false)
+	, m_nQueuedTasks(0)
+	, m_nNextQueueIndex(0)
 	, m_pmtxTask(std::make_shared<std::mutex>()) {
+	m_queues.resize((std::max<size_t>)(1, m_nConcurrency));
+	for (auto& queue : m_queues)
+		queue = std::make_unique<task_queue>();
+	reset_statistics();
 }
 
 xivres::util::thread_pool::pool::~pool() {
 	m_bQuitting = true;
-	m_cvTask.notify_one();
+	notify_free_threads(true);
 
 	std::unique_lock lock(*m_pmtxThread);
 	while (!m_mapThreads.empty())
@@ -24,99 +43,302 @@ xivres::util::thread_pool::pool& xivres::util::thread_pool::pool::instance() {
 }
 
 xivres::util::thread_pool::pool& xivres::util::thread_pool::pool::current() {
-	return instance();
+	return s_pCurrentPool ? *s_pCurrentPool : instance();
 }
 
 void xivres::util::thread_pool::pool::throw_if_current_task_cancelled() {
-	if (const auto pTask = instance().current_task())
-		pTask->throw_if_cancelled(); 
+	if (s_pCurrentThreadInfo && s_pCurrentThreadInfo->Task)
+		s_pCurrentThreadInfo->Task->throw_if_cancelled();
 }
 
 xivres::util::thread_pool::base_task* xivres::util::thread_pool::pool::current_task() const {
-	std::shared_lock lock(*m_pmtxThread);
-	if (const auto it = m_mapThreads.find(std::this_thread::get_id()); it != m_mapThreads.end())
-		return it->second.Task.get();
+	if (const auto pThreadInfo = current_thread_info())
+		return pThreadInfo->Task.get();
 	return nullptr;
 }
 
+xivres::util::thread_pool::pool::thread_info* xivres::util::thread_pool::pool::current_thread_info() const {
+	return s_pCurrentPool == this ? s_pCurrentThreadInfo : nullptr;
+}
+
 void xivres::util::thread_pool::pool::concurrency(size_t newConcurrency) {
-	std::lock_guard lock(*m_pmtxTask);
-	m_nConcurrency = newConcurrency;
-	m_cvTask.notify_one();
+	m_nConcurrency = (std::max<size_t>)(1, newConcurrency);
+	dispatch_task_to_worker();
 }
 
 size_t xivres::util::thread_pool::pool::concurrency() const {
 	return m_nConcurrency;
 }
 
+void xivres::util::thread_pool::pool::collect_statistics(bool enable) {
+	if (enable && !m_statistics.Enabled)
+		reset_statistics();
+	m_statistics.Enabled = enable;
+}
+
+bool xivres::util::thread_pool::pool::collect_statistics() const {
+	return m_statistics.Enabled;
+}
+
+void xivres::util::thread_pool::pool::reset_statistics() {
+	m_statistics.Start = m_statistics.LastReport = std::chrono::steady_clock::now().time_since_epoch().count();
+	m_statistics.SubmittedTaskCount = 0;
+	m_statistics.CompletedTaskCount = 0;
+	m_statistics.CreatedThreadCount = 0;
+	m_statistics.ExitedThreadCount = 0;
+	m_statistics.PeakThreadCount = m_nThreads.load();
+	m_statistics.PeakWaitingThreadCount = m_nWaitingThreads.load();
+	m_statistics.QueueWait.reset();
+	m_statistics.RunTime.reset();
+}
+
+xivres::util::thread_pool::pool::stats xivres::util::thread_pool::pool::statistics() const {
+	return {
+		.Elapsed = std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(m_statistics.Start.load()),
+		.Concurrency = m_nConcurrency,
+		.QueuedTaskCount = m_nQueuedTasks,
+		.ThreadCount = m_nThreads,
+		.PeakThreadCount = m_statistics.PeakThreadCount,
+		.ActiveThreadCount = m_nActiveThreads,
+		.FreeThreadCount = m_nFreeThreads,
+		.WaitingThreadCount = m_nWaitingThreads,
+		.PeakWaitingThreadCount = m_statistics.PeakWaitingThreadCount,
+		.SubmittedTaskCount = m_statistics.SubmittedTaskCount,
+		.CompletedTaskCount = m_statistics.CompletedTaskCount,
+		.CreatedThreadCount = m_statistics.CreatedThreadCount,
+		.ExitedThreadCount = m_statistics.ExitedThreadCount,
+		.QueueWait = m_statistics.QueueWait.stats(),
+		.RunTime = m_statistics.RunTime.stats(),
+	};
+}
+
+double xivres::util::thread_pool::pool::stats::utilization() const {
+	const auto capacity = std::chrono::duration<double>(Elapsed).count() * static_cast<double>(Concurrency);
+	if (capacity <= 0)
+		return 0;
+	return std::chrono::duration<double>(RunTime.Total).count() / capacity;
+}
+
+void xivres::util::thread_pool::pool::record_submit(base_task& task) {
+	task.m_submitTime = std::chrono::steady_clock::now();
+	m_statistics.SubmittedTaskCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void xivres::util::thread_pool::pool::record_run(const base_task& task, std::chrono::steady_clock::time_point start) {
+	const auto now = std::chrono::steady_clock::now();
+	if (task.m_submitTime != std::chrono::steady_clock::time_point{})
+		m_statistics.QueueWait.record(start - task.m_submitTime);
+	m_statistics.RunTime.record(now - start);
+	m_statistics.CompletedTaskCount.fetch_add(1, std::memory_order_relaxed);
+
+	const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(m_statistics.IntervalMilliseconds.load()));
+	if (interval <= std::chrono::steady_clock::duration::zero())
+		return;
+
+	auto last = m_statistics.LastReport.load();
+	if (now.time_since_epoch().count() - last < interval.count() || !m_statistics.LastReport.compare_exchange_strong(last, now.time_since_epoch().count()))
+		return;
+
+	StatisticsCallback(statistics());
+}
+
 bool xivres::util::thread_pool::base_task::operator<(const base_task& r) const {
 	return m_invokePath > r.m_invokePath;
 }
 
 xivres::util::on_dtor xivres::util::thread_pool::pool::release_working_status() {
-	std::lock_guard lock(*m_pmtxTask);
-	if (!m_mapThreads.contains(std::this_thread::get_id()))
+	if (!current_task())
 		return {};
 
-	m_nWaitingThreads += 1;
+	begin_waiting();
+	return { [this] { end_waiting(); } };
+}
+
+void xivres::util::thread_pool::pool::begin_waiting() {
+	update_peak(m_statistics.PeakWaitingThreadCount, ++m_nWaitingThreads);
+	m_nActiveThreads -= 1;
 	dispatch_task_to_worker();
-	return { [this] { m_nWaitingThreads -= 1; } };
 }
 
-void xivres::util::thread_pool::pool::worker_body() {
+void xivres::util::thread_pool::pool::end_waiting() {
+	// Resumes even if that goes over the concurrency; the thread will not take another task until it is under again.
+	m_nActiveThreads += 1;
+	m_nWaitingThreads -= 1;
+}
+
+void xivres::util::thread_pool::pool::push_task(size_t queueIndex, std::shared_ptr<base_task> pTask) {
+	{
+		auto& queue = *m_queues[queueIndex];
+		const auto lock = std::lock_guard(queue.Mtx);
+		queue.Tasks.emplace(std::move(pTask));
+
+		// Counted under the same lock as the pop, so that the count never goes below zero.
+		m_nQueuedTasks += 1;
+	}
+	dispatch_task_to_worker();
+}
+
+bool xivres::util::thread_pool::pool::take_task(size_t queueIndex, std::shared_ptr<base_task>& pTask) {
+	const auto try_pop = [&](task_queue& queue) {
+		const auto lock = std::lock_guard(queue.Mtx);
+		if (queue.Tasks.empty())
+			return false;
+
+		pTask = std::move(const_cast<std::shared_ptr<base_task>&>(queue.Tasks.top()));
+		queue.Tasks.pop();
+		m_nQueuedTasks -= 1;
+		return true;
+	};
+
+	while (m_nQueuedTasks) {
+		for (auto active = m_nActiveThreads.load(); ; ) {
+			if (active >= m_nConcurrency)
+				return false;
+			if (m_nActiveThreads.compare_exchange_weak(active, active + 1))
+				break;
+		}
+
+		if (try_pop(*m_queues[queueIndex]))
+			return true;
+
+		static thread_local uint32_t s_randomState = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+		s_randomState ^= s_randomState << 13;
+		s_randomState ^= s_randomState >> 17;
+		s_randomState ^= s_randomState << 5;
+		for (size_t i = 0, start = s_randomState % m_queues.size(); i < m_queues.size(); ++i) {
+			const auto victimIndex = (start + i) % m_queues.size();
+			if (victimIndex != queueIndex && try_pop(*m_queues[victimIndex]))
+				return true;
+		}
+
+		m_nActiveThreads -= 1;
+
+		// A task pushed while the slot was claimed saw no room and did not dispatch itself, so look again if any is queued.
+	}
+	return false;
+}
+
+void xivres::util::thread_pool::pool::worker_body(size_t queueIndex) {
 	std::shared_ptr pmtxTask(m_pmtxTask);
 	std::shared_ptr pmtxThread(m_pmtxThread);
-	std::unique_lock taskLock(*pmtxTask);
 	std::unique_lock threadLock(*pmtxThread);
 
 	const auto it = m_mapThreads.find(std::this_thread::get_id());
 	threadLock.unlock();
 
-	auto& [thread, pTask] = it->second;
+	s_pCurrentPool = this;
+	s_pCurrentThreadInfo = &it->second;
+
+	auto& [thread, pTask, _] = it->second;
 	while (true) {
-		if (!take_task(pTask)) {
+		if (!take_task(queueIndex, pTask)) {
+			std::unique_lock taskLock(*pmtxTask);
 			const auto waitFrom = std::chrono::steady_clock::now();
 			m_nFreeThreads++;
-			++m_nWaitingThreads;
-			while (!take_task(pTask)) {
-				if (m_bQuitting)
-					break;
-				if (m_cvTask.wait_until(taskLock, waitFrom + m_durMaxThreadInactivity) == std::cv_status::timeout)
+			while (!take_task(queueIndex, pTask) && !m_bQuitting) {
+				if (m_cvTask.wait_until(taskLock, waitFrom + m_durMaxThreadInactivity) == std::cv_status::timeout) {
+					// One last look, for a task that came in right as the wait timed out.
+					take_task(queueIndex, pTask);
 					break;
+				}
 			}
-			--m_nWaitingThreads;
 			m_nFreeThreads--;
 			if (!pTask)
 				break;
 		}
 
-		taskLock.unlock();
-
+		// Let another thread pick up the rest, if any.
 		dispatch_task_to_worker();
-		(*pTask)();
+		if (m_statistics.Enabled.load(std::memory_order_relaxed)) {
+			const auto start = std::chrono::steady_clock::now();
+			(*pTask)();
+			record_run(*pTask, start);
+		} else
+			(*pTask)();
 		pTask.reset();
-
-		taskLock.lock();
+		m_nActiveThreads -= 1;
 	}
 
+	s_pCurrentPool = nullptr;
+	s_pCurrentThreadInfo = nullptr;
+
 	threadLock.lock();
+	m_nThreads -= 1;
+	m_statistics.ExitedThreadCount += 1;
 	thread.detach();
 	m_mapThreads.erase(it);
 	m_cvThread.notify_one();
 }
 
 void xivres::util::thread_pool::pool::dispatch_task_to_worker() {
-	if (m_pqTasks.empty())
+	if (!m_nQueuedTasks || m_nActiveThreads >= m_nConcurrency)
 		return;
 
-	if (m_nFreeThreads == 0 && m_mapThreads.size() - m_nWaitingThreads < m_nConcurrency) {
-		std::unique_lock lock(*m_pmtxThread);
-		auto thread = std::thread(&pool::worker_body, this);
-		const auto threadId = thread.get_id();
-		m_mapThreads[threadId].Thread = std::move(thread);
+	if (m_nFreeThreads) {
+		notify_free_threads(false);
+		return;
 	}
 
-	m_cvTask.notify_one();
+	std::unique_lock lock(*m_pmtxThread);
+	if (m_nFreeThreads || m_nThreads - m_nWaitingThreads >= m_nConcurrency)
+		return;
+
+	const auto queueIndex = m_nThreads % m_queues.size();
+	update_peak(m_statistics.PeakThreadCount, ++m_nThreads);
+	m_statistics.CreatedThreadCount += 1;
+	auto thread = std::thread(&pool::worker_body, this, queueIndex);
+	const auto threadId = thread.get_id();
+	auto& info = m_mapThreads[threadId];
+	info.Thread = std::move(thread);
+	info.QueueIndex = queueIndex;
+}
+
+void xivres::util::thread_pool::pool::notify_free_threads(bool all) {
+	// Taking the lock makes sure that a thread about to sleep either sees the new state or gets notified.
+	const auto lock = std::lock_guard(*m_pmtxTask);
+	if (all)
+		m_cvTask.notify_all();
+	else
+		m_cvTask.notify_one();
+}
+
+thread_local const xivres::util::thread_pool::lane* xivres::util::thread_pool::lane::s_pCurrentLane = nullptr;
+
+xivres::util::thread_pool::lane::lane(size_t concurrency)
+	: m_nConcurrency((std::max<size_t>)(1, concurrency)) {
+}
+
+xivres::util::thread_pool::lane& xivres::util::thread_pool::lane::io() {
+	static lane s_instance(DefaultIoConcurrency);
+	return s_instance;
+}
+
+void xivres::util::thread_pool::lane::concurrency(size_t newConcurrency) {
+	const auto lock = std::lock_guard(m_mtx);
+	m_nConcurrency = (std::max<size_t>)(1, newConcurrency);
+	m_cv.notify_all();
+}
+
+size_t xivres::util::thread_pool::lane::concurrency() const {
+	const auto lock = std::lock_guard(m_mtx);
+	return m_nConcurrency;
+}
+
+size_t xivres::util::thread_pool::lane::active() const {
+	const auto lock = std::lock_guard(m_mtx);
+	return m_nActive;
+}
+
+void xivres::util::thread_pool::lane::enter() {
+	std::unique_lock lock(m_mtx);
+	m_cv.wait(lock, [this] { return m_nActive < m_nConcurrency; });
+	m_nActive++;
+}
+
+void xivres::util::thread_pool::lane::leave() {
+	const auto lock = std::lock_guard(m_mtx);
+	m_nActive--;
+	m_cv.notify_one();
 }
 
 xivres::util::thread_pool::object_pool<std::vector<uint8_t>>::scoped_pooled_object xivres::util::thread_pool::pooled_byte_buffer() {
@@ -0,0 +1,89 @@
+#ifndef XIVRES_PACKEDSTREAMCACHE_H_
+#define XIVRES_PACKEDSTREAMCACHE_H_
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+#include "sqpack.h"
+#include "stream.h"
+
+namespace xivres {
+	// Keeps packed data in a directory, so that packing the same content with the same settings again can be skipped.
+	class packed_stream_cache {
+	public:
+		// Increase whenever a packer starts producing different output for the same input.
+		static constexpr uint32_t PackerVersion = 1;
+
+		struct key {
+			sha1_value ContentSha1;
+			packed::type Type = packed::type::none;
+			int CompressionLevel{};
+			double EntropyThreshold{};
+
+			// Reads the whole stream to hash it.
+			[[nodiscard]] static key of(const stream& unpacked, packed::type type, int compressionLevel);
+
+			[[nodiscard]] std::string file_name() const;
+		};
+
+		struct stats {
+			uint64_t HitCount{};
+			uint64_t MissCount{};
+			uint64_t StoredCount{};
+			uint64_t EvictedCount{};
+			uint64_t HitBytes{};
+			uint64_t StoredBytes{};
+			uint64_t EvictedBytes{};
+		};
+
+	private:
+		struct entry_info {
+			uint64_t Size{};
+			uint64_t LastUse{};
+		};
+
+		const std::filesystem::path m_dir;
+		const uint64_t m_maxBytes;
+
+		mutable std::mutex m_mtx;
+		std::map<std::string, entry_info> m_entries;
+		uint64_t m_totalBytes = 0;
+		uint64_t m_useCounter = 0;
+
+		std::atomic_uint64_t m_hitCount;
+		std::atomic_uint64_t m_missCount;
+		std::atomic_uint64_t m_storedCount;
+		std::atomic_uint64_t m_evictedCount;
+		std::atomic_uint64_t m_hitBytes;
+		std::atomic_uint64_t m_storedBytes;
+		std::atomic_uint64_t m_evictedBytes;
+
+	public:
+		// Once the files in dir add up to more than maxBytes, the least recently used ones get deleted.
+		packed_stream_cache(std::filesystem::path dir, uint64_t maxBytes);
+
+		packed_stream_cache(packed_stream_cache&&) = delete;
+		packed_stream_cache(const packed_stream_cache&) = delete;
+		packed_stream_cache& operator=(packed_stream_cache&&) = delete;
+		packed_stream_cache& operator=(const packed_stream_cache&) = delete;
+
+		[[nodiscard]] std::unique_ptr<stream> find(const key& k);
+		void store(const key& k, const stream& packed);
+
+		[[nodiscard]] uint64_t size() const;
+		[[nodiscard]] uint64_t max_size() const { return m_maxBytes; }
+		[[nodiscard]] const std::filesystem::path& directory() const { return m_dir; }
+		[[nodiscard]] stats statistics() const;
+
+		// Cache consulted by compressing_packed_stream; none by default.
+		static void instance(std::shared_ptr<packed_stream_cache> cache);
+		[[nodiscard]] static std::shared_ptr<packed_stream_cache> instance();
+
+	private:
+		void evict(uint64_t targetBytes);
+	};
+}
+
+#endif
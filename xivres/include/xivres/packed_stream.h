@@ -6,6 +6,7 @@
 
 #include <zlib.h>
 
+#include "packed_stream.cache.h"
 #include "path_spec.h"
 #include "sqpack.h"
 #include "stream.h"
@@ -37,6 +38,9 @@ namespace xivres {
 
 		[[nodiscard]] virtual packed::type get_packed_type() const = 0;
 
+		// Starts preparing the packed data in the background, if it takes time to do so. size() and read() wait for it as needed.
+		virtual void prepare_async() const {}
+
 		unpacked_stream get_unpacked(std::span<uint8_t> obfuscatedHeaderRewrite = {}) const;
 
 		std::unique_ptr<unpacked_stream> make_unpacked_ptr(std::span<uint8_t> obfuscatedHeaderRewrite = {}) const;
@@ -140,6 +144,23 @@ namespace xivres {
 	};
 
 	class compressing_packer {
+	public:
+		// Blocks found incompressible are stored without being deflated. Some of them still get deflated, to estimate what skipping cost, but are stored as is too.
+		// Skipped counts include the sampled blocks.
+		struct incompressible_stats {
+			uint64_t ProbedBlockCount{};
+			uint64_t SkippedBlockCount{};
+			uint64_t SkippedBytes{};
+			uint64_t SampledBlockCount{};
+			uint64_t SampledBytes{};
+			uint64_t SampledDeflatedBytes{};
+			std::chrono::nanoseconds SampledDeflateTime{};
+
+			[[nodiscard]] std::chrono::nanoseconds estimated_time_saved() const;
+			[[nodiscard]] uint64_t estimated_bytes_lost() const;
+		};
+
+	private:
 		const stream& m_stream;
 		const int m_nCompressionLevel;
 		const bool m_bMultithreaded;
@@ -163,8 +184,24 @@ namespace xivres {
 		
 		void cancel() { m_bCancel = true; }
 
+		// Blocks with at least this much entropy, in bits per byte, are considered incompressible. 8 disables the check.
+		static void incompressible_entropy_threshold(double bitsPerByte);
+		[[nodiscard]] static double incompressible_entropy_threshold();
+
+		[[nodiscard]] static incompressible_stats incompressible_statistics();
+		static void reset_incompressible_statistics();
+
 		[[nodiscard]] virtual std::unique_ptr<stream> pack() = 0;
 
+		// Receives a part of the packed data along with where it belongs. Parts may arrive out of order.
+		using output_fn = std::function<void(uint64_t offset, std::span<const uint8_t> data)>;
+
+		// Packs without holding the whole unpacked or packed data in memory, if supported by the packer.
+		// Returns the packed size, or an empty value if cancelled.
+		virtual std::optional<uint64_t> pack_to(const output_fn& output);
+
+		std::optional<uint64_t> pack_to(const std::filesystem::path& path);
+
 	protected:
 		struct block_data_t {
 			bool Deflated{};
@@ -191,6 +228,8 @@ namespace xivres {
 		void preload();
 
 		void compress_block(uint32_t offset, uint32_t length, block_data_t& blockData) const;
+
+		void compress_block(std::vector<uint8_t> buffer, block_data_t& blockData) const;
 	};
 
 	template<typename TPacker, typename = std::enable_if_t<std::is_base_of_v<compressing_packer, TPacker>>>
@@ -199,8 +238,9 @@ namespace xivres {
 
 		mutable std::mutex m_mtx;
 		mutable std::shared_ptr<const stream> m_stream;
-		mutable int m_compressionLevel;
+		mutable std::atomic_int m_compressionLevel;
 		const bool m_bMultithreaded;
+		mutable bool m_bPrepareQueued = false;
 
 	public:
 		compressing_packed_stream(xivres::path_spec spec, std::shared_ptr<const stream> strm, int compressionLevel = Z_BEST_COMPRESSION, bool multithreaded = true)
@@ -224,19 +264,52 @@ namespace xivres {
 			return TPacker::Type;
 		}
 
+		// Packs on the thread pool. Must be owned by a std::shared_ptr.
+		void prepare_async() const final {
+			if (m_compressionLevel == CompressionLevel_AlreadyPacked)
+				return;
+
+			const auto lock = std::lock_guard(m_mtx);
+			if (m_compressionLevel == CompressionLevel_AlreadyPacked || m_bPrepareQueued)
+				return;
+
+			m_bPrepareQueued = true;
+			util::thread_pool::pool::instance().submit<void>([self = std::static_pointer_cast<const compressing_packed_stream>(shared_from_this())](util::thread_pool::task<void>&) {
+				// On failure, size() and read() will try again and throw.
+				self->ensure_initialized();
+			});
+		}
+
 	private:
 		void ensure_initialized() const {
 			if (m_compressionLevel == CompressionLevel_AlreadyPacked)
 				return;
 
-			const auto lock = std::lock_guard(m_mtx);
+			// Another thread may be packing this; let the pool run other tasks meanwhile.
+			auto lock = std::unique_lock(m_mtx, std::try_to_lock);
+			if (!lock.owns_lock())
+				lock = util::thread_pool::pool::current().release_working_status([this] { return std::unique_lock(m_mtx); });
 			if (m_compressionLevel == CompressionLevel_AlreadyPacked)
 				return;
 
+			const auto cache = packed_stream_cache::instance();
+			std::optional<packed_stream_cache::key> cacheKey;
+			if (cache) {
+				cacheKey = packed_stream_cache::key::of(*m_stream, TPacker::Type, m_compressionLevel);
+				if (auto cached = cache->find(*cacheKey)) {
+					m_stream = std::move(cached);
+					m_compressionLevel = CompressionLevel_AlreadyPacked;
+					return;
+				}
+			}
+
 			auto newStream = TPacker(*m_stream, m_compressionLevel, m_bMultithreaded).pack();
 			if (!newStream)
 				throw std::logic_error("TODO; cancellation currently unhandled");
 
+			if (cache)
+				cache->store(*cacheKey, *newStream);
+
 			m_stream = std::move(newStream);
 			m_compressionLevel = CompressionLevel_AlreadyPacked;
 		}
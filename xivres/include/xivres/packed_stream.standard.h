@@ -25,6 +25,9 @@ namespace xivres {
 		using compressing_packer::compressing_packer;
 
 		[[nodiscard]] std::unique_ptr<stream> pack() override;
+
+		std::optional<uint64_t> pack_to(const output_fn& output) override;
+		using compressing_packer::pack_to;
 	};
 }
 
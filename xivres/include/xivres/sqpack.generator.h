@@ -1,10 +1,16 @@
 #ifndef XIVRES_SQPACKGENERATOR_H_
 #define XIVRES_SQPACKGENERATOR_H_
 
+#include <array>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <mutex>
 #include <thread>
 
 #include "sqpack.reader.h"
 #include "unpacked_stream.h"
+#include "util.latency_histogram.h"
 #include "util.listener_manager.h"
 
 namespace xivres::sqpack {
@@ -34,61 +40,224 @@ namespace xivres::sqpack {
 			[[nodiscard]] std::vector<packed_stream*> all_success() const;
 		};
 
+		struct export_stats {
+			size_t DeduplicatedEntryCount{};
+			uint64_t DeduplicatedBytes{};
+		};
+
+		// Stages an entry goes through while being exported.
+		enum class export_stage : size_t {
+			// Finding entries with identical packed data, which involves packing every entry and hashing those that share
+			// their packed size with another. Only done when deduplication is enabled.
+			deduplicate,
+
+			// Getting the packed size, which involves packing for entries that are not packed yet.
+			measure,
+
+			// Reading packed data from the provider.
+			read,
+
+			// Writing packed data into a data file.
+			write,
+
+			count,
+		};
+
+		using latency_stats = util::latency_stats;
+
+		struct export_progress {
+			export_stage Stage = export_stage::measure;
+			std::chrono::steady_clock::duration Elapsed{};
+
+			std::chrono::steady_clock::duration StageElapsed{};
+
+			// StoredEntryCount is known once deduplication is done, and excludes deduplicated entries.
+			// ScannedEntryCount stays zero unless deduplication is enabled.
+			size_t EntryCount{};
+			size_t ScannedEntryCount{};
+			size_t MeasuredEntryCount{};
+			size_t StoredEntryCount{};
+			size_t CompletedEntryCount{};
+
+			uint64_t PackedBytes{};
+			uint64_t ReadBytes{};
+			uint64_t WrittenBytes{};
+
+			// Tasks submitted to the thread pool and not finished yet, and finished ones waiting for their turn to be processed.
+			size_t PendingTaskCount{};
+			size_t BufferedResultCount{};
+
+			std::array<latency_stats, static_cast<size_t>(export_stage::count)> Latency{};
+
+			[[nodiscard]] const latency_stats& latency(export_stage stage) const { return Latency[static_cast<size_t>(stage)]; }
+			[[nodiscard]] double entries_per_second() const;
+			[[nodiscard]] double written_bytes_per_second() const;
+
+			// Assumes that scanning, measuring and writing an entry take about the same time; zero if nothing has been done yet.
+			[[nodiscard]] std::chrono::steady_clock::duration estimated_remaining() const;
+		};
+
+		// Decides the order entries are placed in data files. The index files are the same regardless.
+		enum class layout_order {
+			// The order of the index: entries by full path, then entries without full path by hashes.
+			index,
+
+			// Files in the same directory are placed together, and entries without full path are placed with the directory of
+			// a known entry with the same path hash, if any.
+			path,
+
+			// Grouped by packed type, then by path.
+			type,
+
+			// Entries in AccessCounts, most accessed first, then the others by path.
+			frequency,
+
+			// Entries in AccessTrace, in the order they first appear, then the others by path.
+			access_trace,
+		};
+
+		struct layout_policy {
+			layout_order Order = layout_order::index;
+			std::vector<std::pair<path_spec, uint64_t>> AccessCounts;
+			std::vector<path_spec> AccessTrace;
+		};
+
 		struct sqpack_views {
 			std::shared_ptr<stream> Index1;
 			std::shared_ptr<stream> Index2;
 			std::vector<std::shared_ptr<stream>> Data;
 			std::vector<entry_info*> Entries;
-			std::map<path_spec, std::unique_ptr<entry_info>, path_spec::AllHashComparator> HashOnlyEntries;
-			std::map<path_spec, std::unique_ptr<entry_info>, path_spec::FullPathComparator> FullPathEntries;
+			std::deque<entry_info> EntryStorage;
+
+			// Entries without full path by full path hash, path hash and name hash, and the others by lowercase full path; sorted.
+			std::vector<std::pair<std::tuple<uint32_t, uint32_t, uint32_t>, entry_info*>> HashOnlyEntries;
+			std::vector<std::pair<std::string, entry_info*>> FullPathEntries;
 
 			[[nodiscard]] entry_info* find_entry(const path_spec& pathSpec) const;
 			[[nodiscard]] entry_info& get_entry(const path_spec& pathSpec) const;
 		};
 
+		// Keeps recently read entries of data views in memory, so that reading an entry a piece at a time does not pack it again
+		// for every piece. Entries are spread over shards by their address, and each shard gets an equal part of the byte budget.
+		// Safe to use from multiple threads, and may be shared between views.
 		class sqpack_view_entry_cache {
-			static constexpr auto SmallEntryBufferSize = (INTPTR_MAX == INT64_MAX ? 256 : 8) * 1048576;
-			static constexpr auto LargeEntryBufferSizeMax = (INTPTR_MAX == INT64_MAX ? 1024 : 64) * 1048576;
-
 		public:
+			static constexpr uint64_t DefaultMaxBytes = (INTPTR_MAX == INT64_MAX ? 1024 : 64) * 1048576;
+			static constexpr size_t DefaultShardCount = 8;
+
 			class buffered_entry {
-				const data_view_stream* m_view = nullptr;
-				const entry_info* m_entry = nullptr;
-				std::vector<uint8_t> m_bufferPreallocated;
-				std::vector<uint8_t> m_bufferTemporary;
-				std::span<uint8_t> m_bufferActive;
+				const data_view_stream* const m_view;
+				const entry_info* const m_entry;
+				const uint32_t m_size;
+				std::vector<uint8_t> m_buffer;
+				std::once_flag m_loaded;
+
+				friend class sqpack_view_entry_cache;
 
 			public:
-				bool empty() const { return m_view == nullptr || m_entry == nullptr; }
+				buffered_entry(const data_view_stream* view, const entry_info* entry) : m_view(view), m_entry(entry), m_size(entry->EntrySize) {}
+
 				bool is_same(const data_view_stream* view, const entry_info* entry) const { return m_view == view && m_entry == entry; }
-				void clear();
 				auto get() const { return std::make_pair(m_view, m_entry); }
-				void set(const data_view_stream* view, const entry_info* entry);
-				const auto& buffer() const { return m_bufferActive; }
+				std::span<const uint8_t> buffer() const { return m_buffer; }
+			};
+
+			struct stats {
+				uint64_t HitCount{};
+				uint64_t MissCount{};
+				uint64_t BypassedCount{};
+				uint64_t EvictedCount{};
+				uint64_t HitBytes{};
+				uint64_t MissBytes{};
+				uint64_t EvictedBytes{};
 			};
 
 		private:
-			buffered_entry m_lastActiveEntry;
+			struct shard {
+				mutable std::mutex Mtx;
+
+				// Most recently used first.
+				std::list<std::shared_ptr<buffered_entry>> Entries;
+				std::map<std::pair<const data_view_stream*, const entry_info*>, std::list<std::shared_ptr<buffered_entry>>::iterator> Lookup;
+				uint64_t Bytes = 0;
+			};
+
+			const uint64_t m_maxBytes;
+			const uint64_t m_maxBytesPerShard;
+			std::vector<shard> m_shards;
+
+			std::atomic_uint64_t m_hitCount;
+			std::atomic_uint64_t m_missCount;
+			std::atomic_uint64_t m_bypassedCount;
+			std::atomic_uint64_t m_evictedCount;
+			std::atomic_uint64_t m_hitBytes;
+			std::atomic_uint64_t m_missBytes;
+			std::atomic_uint64_t m_evictedBytes;
 
 		public:
-			buffered_entry* GetBuffer(const data_view_stream* view, const entry_info* entry);
+			// Entries larger than maxBytes / shardCount are not kept, and get read from their providers every time.
+			sqpack_view_entry_cache(uint64_t maxBytes = DefaultMaxBytes, size_t shardCount = DefaultShardCount);
+
+			sqpack_view_entry_cache(sqpack_view_entry_cache&&) = delete;
+			sqpack_view_entry_cache(const sqpack_view_entry_cache&) = delete;
+			sqpack_view_entry_cache& operator=(sqpack_view_entry_cache&&) = delete;
+			sqpack_view_entry_cache& operator=(const sqpack_view_entry_cache&) = delete;
+
+			// Returns the whole packed data of the entry, reading it first if needed, or null if the entry is too large to keep.
+			// If several threads ask for an entry that is not in memory yet, one reads it and the others wait for it.
+			std::shared_ptr<const buffered_entry> GetBuffer(const data_view_stream* view, const entry_info* entry);
+
+			void Flush();
+			void Flush(const data_view_stream* view);
 
-			void Flush() { m_lastActiveEntry.clear(); }
+			[[nodiscard]] uint64_t size() const;
+			[[nodiscard]] uint64_t max_size() const { return m_maxBytes; }
+			[[nodiscard]] stats statistics() const;
+
+		private:
+			shard& shard_of(const entry_info* entry);
+			void evict(shard& s, uint64_t targetBytes);
 		};
 
 		const std::string DatExpac;
 		const std::string DatName;
 
 	private:
-		std::map<path_spec, std::unique_ptr<entry_info>, path_spec::AllHashComparator> m_hashOnlyEntries;
-		std::map<path_spec, std::unique_ptr<entry_info>, path_spec::FullPathComparator> m_fullEntries;
+		struct entry_slot {
+			static constexpr uint32_t Empty = UINT32_MAX;
+			static constexpr uint32_t Removed = UINT32_MAX - 1;
+
+			uint32_t FullPathHash = 0;
+			uint32_t Index = Empty;
+		};
+
+		// Entries are allocated a chunk at a time, and are never moved; removed entries stay with an empty Provider.
+		std::deque<entry_info> m_entries;
+
+		// Open addressing table of indices into m_entries by full path hash, with a size of power of 2.
+		std::vector<entry_slot> m_entrySlots;
+		size_t m_occupiedEntrySlotCount = 0;
+		size_t m_entryCount = 0;
 
 		std::vector<sqindex::segment_3_entry> m_sqpackIndexSegment3;
 		std::vector<sqindex::segment_3_entry> m_sqpackIndex2Segment3;
 
+		bool m_deduplicate = false;
+		bool m_backgroundPacking = false;
+		layout_policy m_layout;
+
+		struct progress_state;
+		std::shared_ptr<progress_state> m_progress;
+		export_stats m_lastExportStats;
+
 	public:
+		// Called from the exporting thread each time a stored entry is done, with the number of entries done so far, starting
+		// from 1, and the number of stored entries; the last call has both equal. Deduplicated entries are not counted.
 		util::listener_manager<generator, void, size_t, size_t> ProgressCallback;
 
+		// Called from the exporting thread as entries get processed, at most once per progress interval, and once at the end.
+		util::listener_manager<generator, void, const export_progress&> ExportProgressCallback;
+
 		generator(std::string ex, std::string name, uint64_t maxFileSize = sqdata::header::MaxFileSize_MaxValue);
 
 		void add(add_result& result, std::shared_ptr<packed_stream> provider, bool overwriteExisting);
@@ -96,13 +265,66 @@ namespace xivres::sqpack {
 		add_result add_sqpack(const std::filesystem::path& indexPath, bool overwriteExisting = true, bool overwriteUnknownSegments = false);
 		add_result add_sqpack(const xivres::sqpack::reader& reader, bool overwriteExisting = true, bool overwriteUnknownSegments = false);
 		add_result add_file(path_spec pathSpec, const std::filesystem::path& path, bool overwriteExisting = true);
+
+		// Receives a file path relative to the directory being added, and returns the path_spec to add it as, or an empty value to skip it.
+		using path_mapper = std::function<std::optional<path_spec>(const std::filesystem::path& relativePath)>;
+
+		// Adds every file under root as add_file would. Listing directories and opening files happen on the thread pool,
+		// while pathMapper is called from the calling thread. If pathMapper is empty, relative paths are used as they are.
+		add_result add_directory(const std::filesystem::path& root, const path_mapper& pathMapper = nullptr, bool overwriteExisting = true);
 		void reserve_space(path_spec pathSpec, uint32_t size);
+		bool remove(const path_spec& pathSpec);
+
+		// If set, entries with byte-identical packed data are stored once, and all of their locators point to the stored copy.
+		// Entries with space reserved using reserve_space are never merged.
+		generator& set_deduplicate(bool deduplicate);
+		[[nodiscard]] bool deduplicate() const { return m_deduplicate; }
+
+		// If set, entries start getting packed on the thread pool as soon as they are added. See packed_stream::prepare_async.
+		generator& set_background_packing(bool backgroundPacking);
+		[[nodiscard]] bool background_packing() const { return m_backgroundPacking; }
+		[[nodiscard]] const export_stats& last_export_stats() const { return m_lastExportStats; }
+
+		generator& set_layout(layout_policy layout);
+		[[nodiscard]] const layout_policy& layout() const { return m_layout; }
+
+		generator& set_progress_interval(std::chrono::milliseconds interval);
+		[[nodiscard]] std::chrono::milliseconds progress_interval() const;
+
+		// Progress of the current or the last export; may be called from any thread.
+		[[nodiscard]] export_progress progress() const;
 
 		[[nodiscard]] sqpack_views export_to_views(bool strict, const std::shared_ptr<sqpack_view_entry_cache>& dataBuffer = nullptr);
 		void export_to_files(const std::filesystem::path& dir, bool strict = false, size_t cores = std::thread::hardware_concurrency());
 
+		[[nodiscard]] static std::pair<std::vector<uint8_t>, std::vector<uint8_t>> export_index_files_data(
+			std::span<const std::pair<path_spec, sqindex::data_locator>> entries,
+			size_t dataFilesCount,
+			std::span<const sqindex::segment_3_entry> index1Segment3,
+			std::span<const sqindex::segment_3_entry> index2Segment3,
+			bool strict);
+
 		[[nodiscard]] std::unique_ptr<default_base_stream> get(const path_spec& pathSpec) const;
 		[[nodiscard]] std::vector<path_spec> all_path_spec() const;
+		[[nodiscard]] size_t size() const { return m_entryCount; }
+
+	private:
+		// Looks up the same way as a pair of maps keyed with AllHashComparator for entries without full path, and
+		// FullPathComparator for the others would, in that order. Returns the index into m_entrySlots, or SIZE_MAX.
+		[[nodiscard]] size_t find_slot(const path_spec& pathSpec) const;
+		entry_info& emplace_entry(uint32_t entrySize, std::shared_ptr<packed_stream> provider);
+		void rehash(size_t slotCount);
+
+		void report_progress(bool force);
+
+		// Takes all entries out, sorted the same way as in sqpack_views.
+		void take_sorted_entries(std::deque<entry_info>& storage, decltype(sqpack_views::HashOnlyEntries)& hashOnlyEntries, decltype(sqpack_views::FullPathEntries)& fullPathEntries);
+
+		// Sorts entries into the order they should be placed in data files, according to m_layout.
+		void apply_layout(std::vector<entry_info*>& entries) const;
+
+		// Returns, for each entry, the index of the first entry carrying byte-identical packed data; unique entries map to themselves.
+		std::vector<size_t> find_duplicate_entries(std::span<entry_info* const> entries);
 	};
 }
 
@@ -0,0 +1,62 @@
+#ifndef XIVRES_SQPACKUPDATER_H_
+#define XIVRES_SQPACKUPDATER_H_
+
+#include "sqpack.generator.h"
+
+namespace xivres::sqpack {
+	// Applies changes to an existing sqpack by appending new data to its .dat files and rewriting only the .index and .index2 files.
+	class updater {
+	public:
+		struct update_result {
+			size_t AppendedEntryCount{};
+			uint64_t AppendedBytes{};
+			size_t RemovedEntryCount{};
+			uint64_t UnreferencedBytes{};
+			bool Compacted{};
+		};
+
+	private:
+		struct entry_info {
+			path_spec PathSpec;
+			sqindex::data_locator Locator;
+			const reader::entry_info* Existing = nullptr;
+
+			// Set if this entry has to be written on commit.
+			std::shared_ptr<packed_stream> Provider;
+		};
+
+		const std::filesystem::path m_indexPath;
+		const uint64_t m_maxFileSize;
+
+		std::optional<reader> m_reader;
+		std::map<path_spec, std::unique_ptr<entry_info>, path_spec::AllHashComparator> m_hashOnlyEntries;
+		std::map<path_spec, std::unique_ptr<entry_info>, path_spec::FullPathComparator> m_fullEntries;
+		std::vector<path_spec> m_removed;
+
+	public:
+		updater(std::filesystem::path indexPath, uint64_t maxFileSize = sqdata::header::MaxFileSize_Value);
+
+		void add(std::shared_ptr<packed_stream> provider);
+		bool remove(const path_spec& pathSpec);
+
+		// Number of bytes in .dat files that would not be referenced by any entry, were the pending changes committed.
+		[[nodiscard]] uint64_t unreferenced_bytes() const;
+
+		// If unreferenced bytes exceed compactionThreshold, the whole sqpack gets rewritten instead.
+		update_result commit(bool strict = false, uint64_t compactionThreshold = UINT64_MAX);
+
+	private:
+		void load();
+		void compact(bool strict);
+
+		// Moves the files of a committed compaction into place, if one was interrupted.
+		void finish_compaction() const;
+
+		[[nodiscard]] std::vector<entry_info*> all_entries() const;
+		[[nodiscard]] std::string dat_name() const;
+		[[nodiscard]] std::filesystem::path compacted_dir() const;
+		[[nodiscard]] std::filesystem::path data_path(size_t index) const;
+	};
+}
+
+#endif
@@ -126,6 +126,22 @@ namespace xivres {
 		std::streamsize read(std::streamoff offset, void* buf, std::streamsize length) const override;
 	};
 
+	// Creates a file, and writes to it at given offsets. Multiple threads may write at once, as long as the ranges do not overlap.
+	class positional_file_writer {
+		struct data;
+		std::unique_ptr<data> m_data;
+
+	public:
+		positional_file_writer(std::filesystem::path path);
+		positional_file_writer(positional_file_writer&&) noexcept;
+		positional_file_writer& operator=(positional_file_writer&&) noexcept;
+		positional_file_writer(const positional_file_writer&) = delete;
+		positional_file_writer& operator=(const positional_file_writer&) = delete;
+		~positional_file_writer();
+
+		void write(uint64_t offset, const void* buf, size_t length) const;
+	};
+
 	class memory_stream : public default_base_stream {
 		std::vector<uint8_t> m_buffer;
 		std::span<const uint8_t> m_view;
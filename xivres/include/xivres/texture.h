@@ -107,12 +107,14 @@ namespace xivres::texture {
 		static constexpr format_type DXT1 = 0x3420;
 		static constexpr format_type DXT3 = 0x3430;
 		static constexpr format_type DXT5 = 0x3431;
+		static constexpr format_type ATI1 = 0x6120;
 		static constexpr format_type ATI2 = 0x6230;
 
 		// Block compression types (DX11 names)
 		static constexpr format_type BC1 = 0x3420;
 		static constexpr format_type BC2 = 0x3430;
 		static constexpr format_type BC3 = 0x3431;
+		static constexpr format_type BC4 = 0x6120;
 		static constexpr format_type BC5 = 0x6230;
 		static constexpr format_type BC7 = 0x6432;
 
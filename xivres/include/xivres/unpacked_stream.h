@@ -2,6 +2,7 @@
 #define XIVRES_PACKEDFILEUNPACKINGSTREAM_H_
 
 #include "packed_stream.h"
+#include "util.co_task.h"
 #include "util.thread_pool.h"
 #include "util.zlib_wrapper.h"
 
@@ -22,11 +23,20 @@ namespace xivres {
 		util::thread_pool::object_pool<std::vector<uint8_t>> m_preloads;
 
 		class block_decoder {
+		public:
+			struct deferred_block {
+				std::span<const uint8_t> Data;
+				std::span<uint8_t> Target;
+				size_t Skip;
+			};
+
+		private:
 			static constexpr auto ReadBufferMaxSize = 16384;
 
 			base_unpacker& m_unpacker;
 			util::thread_pool::task_waiter<> m_waiter;
 			bool m_bMultithreaded = false;
+			std::vector<deferred_block>* m_pDeferredBlocks = nullptr;
 
 			const std::span<uint8_t> m_target;
 			std::span<uint8_t> m_remaining;
@@ -43,6 +53,9 @@ namespace xivres {
 
 			void multithreaded(bool m) { m_bMultithreaded = m; }
 
+			// Compressed blocks get collected here instead of being decoded, for the caller to decode them later.
+			void defer_to(std::vector<deferred_block>* pDeferredBlocks) { m_pDeferredBlocks = pDeferredBlocks; }
+
 			bool skip(size_t lengthToSkip, bool dataFilled = false);
 
 			bool skip_to(size_t offset, bool dataFilled = false);
@@ -57,8 +70,9 @@ namespace xivres {
 
 			[[nodiscard]] std::streamsize filled() { m_waiter.wait_all(); return static_cast<std::streamsize>(m_target.size() - m_remaining.size()); }
 
-		private:
-			void decode_block_to(std::span<const uint8_t> data, std::span<uint8_t> target, size_t skip) const;
+			static void decode_block_to(std::span<const uint8_t> data, std::span<uint8_t> target, size_t skip);
+
+			static util::thread_pool::co_task<> decode_block_async(deferred_block block);
 		};
 
 		const uint32_t m_size, m_packedSize;
@@ -24,6 +24,10 @@ namespace xivres {
 		standard_unpacker(const packed::file_header& header, std::shared_ptr<const packed_stream> strm);
 
 		std::streamsize read(std::streamoff offset, void* buf, std::streamsize length) override;
+
+		// Same as read, but does not hold a worker thread while reading from the packed stream or waiting for blocks
+		// decoded on other threads.
+		util::thread_pool::co_task<std::streamsize> read_async(std::streamoff offset, void* buf, std::streamsize length);
 	};
 }
 
@@ -0,0 +1,296 @@
+#ifndef XIVRES_INTERNAL_COTASK_H_
+#define XIVRES_INTERNAL_COTASK_H_
+
+#include <coroutine>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "stream.h"
+#include "util.thread_pool.h"
+
+namespace xivres::util::thread_pool {
+	template<typename T = void>
+	class co_task;
+
+	namespace implementation_co_task {
+		template<typename T>
+		struct when_all_awaiter;
+
+		struct sync_waiter {
+			std::mutex Mtx;
+			std::condition_variable Cv;
+			bool Done = false;
+		};
+
+		struct promise_base {
+			// Resumed once this task finishes; if this task is awaited along with others, only by the last one to finish.
+			std::coroutine_handle<> Continuation;
+			std::atomic_size_t* RemainingSiblingCount = nullptr;
+
+			sync_waiter* SyncWaiter = nullptr;
+			std::exception_ptr Exception;
+
+			struct final_awaiter {
+				[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+				// The frame may be gone as soon as whoever waits for it gets to run, so nothing touches it after notifying.
+				template<typename TPromise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> handle) const noexcept {
+					auto& promise = handle.promise();
+					if (promise.RemainingSiblingCount && --*promise.RemainingSiblingCount)
+						return std::noop_coroutine();
+					if (promise.Continuation)
+						return promise.Continuation;
+
+					if (const auto pWaiter = promise.SyncWaiter) {
+						const auto lock = std::lock_guard(pWaiter->Mtx);
+						pWaiter->Done = true;
+						pWaiter->Cv.notify_all();
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept {}
+			};
+
+			[[nodiscard]] std::suspend_always initial_suspend() const noexcept { return {}; }
+
+			[[nodiscard]] final_awaiter final_suspend() const noexcept { return {}; }
+
+			void unhandled_exception() noexcept { Exception = std::current_exception(); }
+		};
+
+		template<typename T>
+		struct promise : promise_base {
+			std::optional<T> Value;
+
+			co_task<T> get_return_object();
+
+			template<typename TValue>
+			void return_value(TValue&& value) { Value.emplace(std::forward<TValue>(value)); }
+
+			T take() {
+				if (Exception)
+					std::rethrow_exception(Exception);
+				return std::move(*Value);
+			}
+		};
+
+		template<>
+		struct promise<void> : promise_base {
+			co_task<void> get_return_object();
+
+			void return_void() const noexcept {}
+
+			void take() const {
+				if (Exception)
+					std::rethrow_exception(Exception);
+			}
+		};
+
+		// The pool to continue on after waiting for something that finishes on another thread, if the awaiting coroutine
+		// is running on a worker thread.
+		inline pool* resuming_pool() {
+			auto& currentPool = pool::current();
+			return currentPool.current_task() ? &currentPool : nullptr;
+		}
+
+		inline void resume_on(pool* pPool, std::coroutine_handle<> handle) {
+			if (pPool)
+				pPool->submit<void>([handle](task<void>&) { handle.resume(); });
+			else
+				handle.resume();
+		}
+	}
+
+	// A coroutine that starts when awaited, or when get is called. Waiting for something with co_await suspends the
+	// coroutine, instead of blocking the thread it is running on; see resume_on, when_all, read_fully_async, and co_get.
+	template<typename T>
+	class co_task {
+		template<typename>
+		friend struct implementation_co_task::when_all_awaiter;
+
+	public:
+		using promise_type = implementation_co_task::promise<T>;
+
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+
+	public:
+		co_task() = default;
+
+		explicit co_task(std::coroutine_handle<promise_type> handle)
+			: m_handle(handle) {
+		}
+
+		co_task(co_task&& r) noexcept
+			: m_handle(std::exchange(r.m_handle, nullptr)) {
+		}
+
+		co_task& operator=(co_task&& r) noexcept {
+			if (this != &r) {
+				if (m_handle)
+					m_handle.destroy();
+				m_handle = std::exchange(r.m_handle, nullptr);
+			}
+			return *this;
+		}
+
+		co_task(const co_task&) = delete;
+		co_task& operator=(const co_task&) = delete;
+
+		~co_task() {
+			if (m_handle)
+				m_handle.destroy();
+		}
+
+		// Runs on the calling thread until the coroutine first suspends, and then waits for it to finish.
+		T get() {
+			implementation_co_task::sync_waiter waiter;
+			m_handle.promise().SyncWaiter = &waiter;
+			m_handle.resume();
+			{
+				std::unique_lock lock(waiter.Mtx);
+				if (!waiter.Done)
+					pool::current().release_working_status([&] { waiter.Cv.wait(lock, [&] { return waiter.Done; }); });
+			}
+			return m_handle.promise().take();
+		}
+
+		// Runs the coroutine on the awaiting thread, and continues the awaiting coroutine where this one finishes.
+		auto operator co_await() && noexcept {
+			struct awaiter {
+				std::coroutine_handle<promise_type> Handle;
+
+				[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+					Handle.promise().Continuation = awaiting;
+					return Handle;
+				}
+
+				T await_resume() const { return Handle.promise().take(); }
+			};
+			return awaiter{m_handle};
+		}
+	};
+
+	template<typename T>
+	co_task<T> implementation_co_task::promise<T>::get_return_object() {
+		return co_task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+	}
+
+	inline co_task<void> implementation_co_task::promise<void>::get_return_object() {
+		return co_task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+	}
+
+	// Continues the awaiting coroutine on a worker thread of the pool.
+	inline auto resume_on(pool& targetPool) {
+		struct awaiter {
+			pool& Pool;
+
+			[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<> handle) const { implementation_co_task::resume_on(&Pool, handle); }
+
+			void await_resume() const noexcept {}
+		};
+		return awaiter{targetPool};
+	}
+
+	namespace implementation_co_task {
+		template<typename T>
+		struct when_all_awaiter {
+			std::vector<co_task<T>> Tasks;
+			pool& Pool;
+
+			// One more than the tasks not finished yet, until await_suspend is done with Tasks.
+			std::atomic_size_t Remaining;
+
+			[[nodiscard]] bool await_ready() const noexcept { return Tasks.empty(); }
+
+			bool await_suspend(std::coroutine_handle<> awaiting) {
+				Remaining = Tasks.size() + 1;
+				for (auto& task : Tasks) {
+					task.m_handle.promise().Continuation = awaiting;
+					task.m_handle.promise().RemainingSiblingCount = &Remaining;
+					resume_on(&Pool, task.m_handle);
+				}
+				return --Remaining != 0;
+			}
+
+			auto await_resume() {
+				if constexpr (std::is_void_v<T>) {
+					for (auto& task : Tasks)
+						task.m_handle.promise().take();
+				} else {
+					std::vector<T> results;
+					results.reserve(Tasks.size());
+					for (auto& task : Tasks)
+						results.emplace_back(task.m_handle.promise().take());
+					return results;
+				}
+			}
+		};
+	}
+
+	// Runs the tasks on the pool at the same time, and continues the awaiting coroutine once all of them have finished.
+	// Results are in the order of the tasks; the exception of the earliest task that failed gets rethrown.
+	template<typename T>
+	auto when_all(std::vector<co_task<T>> tasks, pool& targetPool = pool::current()) {
+		return implementation_co_task::when_all_awaiter<T>{std::move(tasks), targetPool};
+	}
+
+	// Reads on a worker thread of ioPool, and continues the awaiting coroutine on the pool it was running on, if any.
+	inline auto read_fully_async(const stream& strm, std::streamoff offset, std::span<uint8_t> buf, pool& ioPool = pool::instance()) {
+		struct awaiter {
+			const stream& Stream;
+			std::streamoff Offset;
+			std::span<uint8_t> Buffer;
+			pool& IoPool;
+			std::exception_ptr Exception;
+
+			[[nodiscard]] bool await_ready() const noexcept { return Buffer.empty(); }
+
+			void await_suspend(std::coroutine_handle<> handle) {
+				IoPool.submit<void>([this, handle, pResumePool = implementation_co_task::resuming_pool()](task<void>&) {
+					try {
+						Stream.read_fully(Offset, Buffer.data(), static_cast<std::streamsize>(Buffer.size_bytes()));
+					} catch (...) {
+						Exception = std::current_exception();
+					}
+					implementation_co_task::resume_on(pResumePool == &IoPool ? nullptr : pResumePool, handle);
+				});
+			}
+
+			void await_resume() const {
+				if (Exception)
+					std::rethrow_exception(Exception);
+			}
+		};
+		return awaiter{strm, offset, buf, ioPool};
+	}
+
+	// Continues the awaiting coroutine once get of the waiter would not wait, and returns what get returns.
+	// Coroutines and threads calling get on the same waiter at the same time may take the results meant for each other.
+	template<typename TReturn>
+	auto co_get(task_waiter<TReturn>& waiter) {
+		struct awaiter {
+			task_waiter<TReturn>& Waiter;
+
+			[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+			bool await_suspend(std::coroutine_handle<> handle) const {
+				return Waiter.on_next_ready([handle, pResumePool = implementation_co_task::resuming_pool()] {
+					implementation_co_task::resume_on(pResumePool, handle);
+				});
+			}
+
+			auto await_resume() const { return Waiter.get(); }
+		};
+		return awaiter{waiter};
+	}
+}
+
+#endif
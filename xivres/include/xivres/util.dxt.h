@@ -8,6 +8,9 @@
 // From https://github.com/Benjamin-Dobell/s3tc-dxt-decompression/blob/master/s3tc.h
 #pragma warning(push, 0)
 namespace xivres::util {
+	// BlockDecompressImage* decode with SSE4.1 or AVX2 when available, producing the same pixels as DecompressBlock*, and
+	// write nothing past width and height.
+
 	// void DecompressBlockDXT1(): Decompresses one block of a DXT1 texture and stores the resulting pixels at the appropriate offset in 'image'.
 	//
 	// uint32_t x:                     x-coordinate of the first pixel in the block.
@@ -26,6 +29,23 @@ namespace xivres::util {
 	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
 	void BlockDecompressImageDXT1(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
 
+	// void DecompressBlockDXT3(): Decompresses one block of a DXT3 texture and stores the resulting pixels at the appropriate offset in 'image'.
+	//
+	// uint32_t x:                     x-coordinate of the first pixel in the block.
+	// uint32_t y:                     y-coordinate of the first pixel in the block.
+	// uint32_t width:                 width of the texture being decompressed.
+	// const uint8_t *blockStorage:   pointer to the block to decompress.
+	// uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
+	void DecompressBlockDXT3(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void BlockDecompressImageDXT3(): Decompresses all the blocks of a DXT3 compressed texture and stores the resulting pixels in 'image'.
+	//
+	// uint32_t width:                 Texture width.
+	// uint32_t height:                Texture height.
+	// const uint8_t *blockStorage:   pointer to compressed DXT3 blocks.
+	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
+	void BlockDecompressImageDXT3(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
+
 	// void DecompressBlockDXT5(): Decompresses one block of a DXT5 texture and stores the resulting pixels at the appropriate offset in 'image'.
 	//
 	// uint32_t x:                     x-coordinate of the first pixel in the block.
@@ -43,6 +63,57 @@ namespace xivres::util {
 	// const uint8_t *blockStorage:   pointer to compressed DXT5 blocks.
 	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
 	void BlockDecompressImageDXT5(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void DecompressBlockBC4(): Decompresses one block of a BC4 texture, with the single channel going to red, and stores the resulting pixels at the appropriate offset in 'image'.
+	//
+	// uint32_t x:                     x-coordinate of the first pixel in the block.
+	// uint32_t y:                     y-coordinate of the first pixel in the block.
+	// uint32_t width:                 width of the texture being decompressed.
+	// const uint8_t *blockStorage:   pointer to the block to decompress.
+	// uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
+	void DecompressBlockBC4(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void BlockDecompressImageBC4(): Decompresses all the blocks of a BC4 compressed texture and stores the resulting pixels in 'image'.
+	//
+	// uint32_t width:                 Texture width.
+	// uint32_t height:                Texture height.
+	// const uint8_t *blockStorage:   pointer to compressed BC4 blocks.
+	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
+	void BlockDecompressImageBC4(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void DecompressBlockBC5(): Decompresses one block of a BC5 texture, with the two channels going to red and green, and stores the resulting pixels at the appropriate offset in 'image'.
+	//
+	// uint32_t x:                     x-coordinate of the first pixel in the block.
+	// uint32_t y:                     y-coordinate of the first pixel in the block.
+	// uint32_t width:                 width of the texture being decompressed.
+	// const uint8_t *blockStorage:   pointer to the block to decompress.
+	// uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
+	void DecompressBlockBC5(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void BlockDecompressImageBC5(): Decompresses all the blocks of a BC5 compressed texture and stores the resulting pixels in 'image'.
+	//
+	// uint32_t width:                 Texture width.
+	// uint32_t height:                Texture height.
+	// const uint8_t *blockStorage:   pointer to compressed BC5 blocks.
+	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
+	void BlockDecompressImageBC5(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void DecompressBlockBC7(): Decompresses one block of a BC7 texture, and stores the resulting pixels at the appropriate offset in 'image'.
+	//
+	// uint32_t x:                     x-coordinate of the first pixel in the block.
+	// uint32_t y:                     y-coordinate of the first pixel in the block.
+	// uint32_t width:                 width of the texture being decompressed.
+	// const uint8_t *blockStorage:   pointer to the block to decompress.
+	// uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
+	void DecompressBlockBC7(uint32_t x, uint32_t y, uint32_t width, const uint8_t* blockStorage, b8g8r8a8* image);
+
+	// void BlockDecompressImageBC7(): Decompresses all the blocks of a BC7 compressed texture and stores the resulting pixels in 'image'.
+	//
+	// uint32_t width:                 Texture width.
+	// uint32_t height:                Texture height.
+	// const uint8_t *blockStorage:   pointer to compressed BC7 blocks.
+	// uint32_t *image:                pointer to the image where the decompressed pixels will be stored.
+	void BlockDecompressImageBC7(uint32_t width, uint32_t height, const uint8_t* blockStorage, b8g8r8a8* image);
 }
 #pragma warning(pop)
 
@@ -0,0 +1,77 @@
+#ifndef XIVRES_INTERNAL_LATENCYHISTOGRAM_H_
+#define XIVRES_INTERNAL_LATENCYHISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+
+namespace xivres::util {
+	// Latencies are counted in buckets of powers of 2, so each percentile is accurate within a factor of 2.
+	struct latency_stats {
+		uint64_t Count{};
+		std::chrono::nanoseconds P50{};
+		std::chrono::nanoseconds P90{};
+		std::chrono::nanoseconds P99{};
+		std::chrono::nanoseconds Max{};
+		std::chrono::nanoseconds Total{};
+	};
+
+	// Records latencies from any number of threads at once without locking.
+	class latency_histogram {
+		static constexpr size_t BucketCount = 64;
+
+		// Bucket n counts latencies in nanoseconds of bit width n.
+		std::array<std::atomic_uint64_t, BucketCount> m_buckets{};
+		std::atomic_uint64_t m_maxNanoseconds{};
+		std::atomic_uint64_t m_totalNanoseconds{};
+
+	public:
+		void record(std::chrono::steady_clock::duration elapsed) {
+			const auto ns = static_cast<uint64_t>((std::max<int64_t>)(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+			m_buckets[(std::min<size_t>)(BucketCount - 1, std::bit_width(ns))].fetch_add(1, std::memory_order_relaxed);
+			m_totalNanoseconds.fetch_add(ns, std::memory_order_relaxed);
+
+			for (auto prev = m_maxNanoseconds.load(std::memory_order_relaxed); prev < ns && !m_maxNanoseconds.compare_exchange_weak(prev, ns, std::memory_order_relaxed);) {
+				// pass
+			}
+		}
+
+		void reset() {
+			for (auto& bucket : m_buckets)
+				bucket = 0;
+			m_maxNanoseconds = 0;
+			m_totalNanoseconds = 0;
+		}
+
+		[[nodiscard]] latency_stats stats() const {
+			latency_stats res;
+			std::array<uint64_t, BucketCount> counts{};
+			for (size_t i = 0; i < BucketCount; ++i)
+				res.Count += counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+			res.Max = std::chrono::nanoseconds(m_maxNanoseconds.load(std::memory_order_relaxed));
+			res.Total = std::chrono::nanoseconds(m_totalNanoseconds.load(std::memory_order_relaxed));
+			if (!res.Count)
+				return res;
+
+			// Reports the upper bound of the bucket the percentile falls in.
+			const auto percentile = [&](uint64_t permille) {
+				const auto target = (res.Count * permille + 999) / 1000;
+				uint64_t cumulative = 0;
+				for (size_t i = 0; i < BucketCount; ++i) {
+					cumulative += counts[i];
+					if (cumulative >= target)
+						return (std::min)(res.Max, std::chrono::nanoseconds(i == 0 ? 0 : static_cast<int64_t>((uint64_t{1} << i) - 1)));
+				}
+				return res.Max;
+			};
+			res.P50 = percentile(500);
+			res.P90 = percentile(900);
+			res.P99 = percentile(990);
+			return res;
+		}
+	};
+}
+
+#endif
@@ -23,6 +23,7 @@
 #define XIVRES_INTERNAL_TINYSHA1_H_
 
 #include <cstdint>
+#include <cstring>
 #include <span>
 
 #include "common.h"
@@ -34,11 +35,13 @@ namespace xivres::util {
 		typedef uint32_t digest32_t[5];
 		typedef uint8_t digest8_t[20];
 
+		static constexpr size_t BlockSize = 64;
+
 	private:
 		digest32_t m_digest;
-		uint8_t m_block[64];
+		uint8_t m_block[BlockSize];
 		size_t m_blockByteIndex;
-		size_t m_byteCount;
+		uint64_t m_byteCount;
 
 	public:
 		hash_sha1() {
@@ -53,7 +56,7 @@ namespace xivres::util {
 			if (this == &s)
 				return *this;
 			memcpy(m_digest, s.m_digest, 5 * sizeof(uint32_t));
-			memcpy(m_block, s.m_block, 64);
+			memcpy(m_block, s.m_block, BlockSize);
 			m_blockByteIndex = s.m_blockByteIndex;
 			m_byteCount = s.m_byteCount;
 			return *this;
@@ -75,54 +78,64 @@ namespace xivres::util {
 		}
 
 		hash_sha1& process_byte(uint8_t octet) {
-			this->m_block[this->m_blockByteIndex++] = octet;
-			++this->m_byteCount;
-			if (m_blockByteIndex == 64) {
-				this->m_blockByteIndex = 0;
-				process_block();
+			m_block[m_blockByteIndex++] = octet;
+			++m_byteCount;
+			if (m_blockByteIndex == BlockSize) {
+				m_blockByteIndex = 0;
+				process_blocks(m_digest, m_block, 1);
 			}
 			return *this;
 		}
 
 		hash_sha1& process_block(const void* const start, const void* const end) {
-			auto begin = static_cast<const uint8_t*>(start);
-			const auto finish = static_cast<const uint8_t*>(end);
-			while (begin != finish) {
-				process_byte(*begin);
-				begin++;
-			}
-			return *this;
+			return process_bytes(start, static_cast<size_t>(static_cast<const uint8_t*>(end) - static_cast<const uint8_t*>(start)));
 		}
 
 		hash_sha1& process_bytes(const void* const data, size_t len) {
-			const auto block = static_cast<const uint8_t*>(data);
-			process_block(block, block + len);
+			auto ptr = static_cast<const uint8_t*>(data);
+			m_byteCount += len;
+
+			if (m_blockByteIndex) {
+				const auto available = (std::min)(len, BlockSize - m_blockByteIndex);
+				memcpy(&m_block[m_blockByteIndex], ptr, available);
+				m_blockByteIndex += available;
+				ptr += available;
+				len -= available;
+				if (m_blockByteIndex < BlockSize)
+					return *this;
+
+				m_blockByteIndex = 0;
+				process_blocks(m_digest, m_block, 1);
+			}
+
+			// Full blocks are hashed directly from the input.
+			if (const auto blockCount = len / BlockSize) {
+				process_blocks(m_digest, ptr, blockCount);
+				ptr += blockCount * BlockSize;
+				len -= blockCount * BlockSize;
+			}
+
+			if (len) {
+				memcpy(m_block, ptr, len);
+				m_blockByteIndex = len;
+			}
 			return *this;
 		}
 
 		const uint32_t* get_digest(digest32_t digest) {
-			size_t bitCount = this->m_byteCount * 8;
-			process_byte(0x80);
-			if (this->m_blockByteIndex > 56) {
-				while (m_blockByteIndex != 0) {
-					process_byte(0);
-				}
-				while (m_blockByteIndex < 56) {
-					process_byte(0);
-				}
-			} else {
-				while (m_blockByteIndex < 56) {
-					process_byte(0);
-				}
+			const auto bitCount = m_byteCount * 8;
+
+			m_block[m_blockByteIndex++] = 0x80;
+			if (m_blockByteIndex > BlockSize - 8) {
+				memset(&m_block[m_blockByteIndex], 0, BlockSize - m_blockByteIndex);
+				process_blocks(m_digest, m_block, 1);
+				m_blockByteIndex = 0;
 			}
-			process_byte(0);
-			process_byte(0);
-			process_byte(0);
-			process_byte(0);
-			process_byte(static_cast<unsigned char>((bitCount >> 24) & 0xFF));
-			process_byte(static_cast<unsigned char>((bitCount >> 16) & 0xFF));
-			process_byte(static_cast<unsigned char>((bitCount >> 8) & 0xFF));
-			process_byte(static_cast<unsigned char>((bitCount) & 0xFF));
+			memset(&m_block[m_blockByteIndex], 0, BlockSize - 8 - m_blockByteIndex);
+			for (size_t i = 0; i < 8; i++)
+				m_block[BlockSize - 1 - i] = static_cast<uint8_t>(bitCount >> (8 * i));
+			process_blocks(m_digest, m_block, 1);
+			m_blockByteIndex = 0;
 
 			memcpy(digest, m_digest, 5 * sizeof(uint32_t));
 			return digest;
@@ -131,88 +144,17 @@ namespace xivres::util {
 		const uint8_t* get_digest_bytes(digest8_t digest) {
 			digest32_t d32;
 			get_digest(d32);
-			size_t di = 0;
-			digest[di++] = ((d32[0] >> 24) & 0xFF);
-			digest[di++] = ((d32[0] >> 16) & 0xFF);
-			digest[di++] = ((d32[0] >> 8) & 0xFF);
-			digest[di++] = ((d32[0]) & 0xFF);
-
-			digest[di++] = ((d32[1] >> 24) & 0xFF);
-			digest[di++] = ((d32[1] >> 16) & 0xFF);
-			digest[di++] = ((d32[1] >> 8) & 0xFF);
-			digest[di++] = ((d32[1]) & 0xFF);
-
-			digest[di++] = ((d32[2] >> 24) & 0xFF);
-			digest[di++] = ((d32[2] >> 16) & 0xFF);
-			digest[di++] = ((d32[2] >> 8) & 0xFF);
-			digest[di++] = ((d32[2]) & 0xFF);
-
-			digest[di++] = ((d32[3] >> 24) & 0xFF);
-			digest[di++] = ((d32[3] >> 16) & 0xFF);
-			digest[di++] = ((d32[3] >> 8) & 0xFF);
-			digest[di++] = ((d32[3]) & 0xFF);
-
-			digest[di++] = ((d32[4] >> 24) & 0xFF);
-			digest[di++] = ((d32[4] >> 16) & 0xFF);
-			digest[di++] = ((d32[4] >> 8) & 0xFF);
-			digest[di++] = ((d32[4]) & 0xFF);
-			return digest;
-		}
-
-	private:
-		void process_block() {
-			uint32_t w[80];
-			for (size_t i = 0; i < 16; i++) {
-				w[i] = (m_block[i * 4 + 0] << 24);
-				w[i] |= (m_block[i * 4 + 1] << 16);
-				w[i] |= (m_block[i * 4 + 2] << 8);
-				w[i] |= (m_block[i * 4 + 3]);
-			}
-			for (size_t i = 16; i < 80; i++) {
-				w[i] = left_rotate((w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16]), 1);
+			for (size_t i = 0; i < 5; i++) {
+				digest[i * 4 + 0] = static_cast<uint8_t>(d32[i] >> 24);
+				digest[i * 4 + 1] = static_cast<uint8_t>(d32[i] >> 16);
+				digest[i * 4 + 2] = static_cast<uint8_t>(d32[i] >> 8);
+				digest[i * 4 + 3] = static_cast<uint8_t>(d32[i]);
 			}
-
-			uint32_t a = m_digest[0];
-			uint32_t b = m_digest[1];
-			uint32_t c = m_digest[2];
-			uint32_t d = m_digest[3];
-			uint32_t e = m_digest[4];
-
-			for (std::size_t i = 0; i < 80; ++i) {
-				uint32_t f;
-				uint32_t k;
-
-				if (i < 20) {
-					f = (b & c) | (~b & d);
-					k = 0x5A827999;
-				} else if (i < 40) {
-					f = b ^ c ^ d;
-					k = 0x6ED9EBA1;
-				} else if (i < 60) {
-					f = (b & c) | (b & d) | (c & d);
-					k = 0x8F1BBCDC;
-				} else {
-					f = b ^ c ^ d;
-					k = 0xCA62C1D6;
-				}
-				uint32_t temp = left_rotate(a, 5) + f + e + k + w[i];
-				e = d;
-				d = c;
-				c = left_rotate(b, 30);
-				b = a;
-				a = temp;
-			}
-
-			m_digest[0] += a;
-			m_digest[1] += b;
-			m_digest[2] += c;
-			m_digest[3] += d;
-			m_digest[4] += e;
+			return digest;
 		}
 
-		static uint32_t left_rotate(uint32_t value, size_t count) {
-			return (value << count) ^ (value >> (32 - count));
-		}
+		// Runs the compression function over consecutive 64-byte blocks, using SHA extensions of the CPU if available.
+		static void process_blocks(digest32_t digest, const uint8_t* blocks, size_t blockCount);
 	};
 }
 
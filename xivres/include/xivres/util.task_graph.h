@@ -0,0 +1,183 @@
+#ifndef XIVRES_INTERNAL_TASKGRAPH_H_
+#define XIVRES_INTERNAL_TASKGRAPH_H_
+
+#include <deque>
+#include <initializer_list>
+#include <span>
+
+#include "util.thread_pool.h"
+
+namespace xivres::util::thread_pool {
+	// Runs each node on the pool once all the nodes it depends on have finished.
+	// A node that fails or gets cancelled cancels every node that depends on it, directly or not.
+	class task_graph {
+	public:
+		using node_id = size_t;
+
+		enum class node_state {
+			pending,
+			running,
+			finished,
+			failed,
+			cancelled,
+		};
+
+	private:
+		struct node {
+			std::function<void(base_task&)> Fn;
+			std::vector<node_id> Dependents;
+			size_t RemainingDependencyCount{};
+			node_state State = node_state::pending;
+			std::shared_ptr<task<void>> Task;
+		};
+
+		pool& m_pool;
+
+		mutable std::mutex m_mtx;
+		std::condition_variable m_cv;
+		std::deque<node> m_nodes;
+		size_t m_nUnsettledNodes = 0;
+		size_t m_nScheduledTasks = 0;
+		std::exception_ptr m_exception;
+
+	public:
+		task_graph(pool& pool = pool::current());
+
+		task_graph(task_graph&&) = delete;
+		task_graph(const task_graph&) = delete;
+		task_graph& operator=(task_graph&&) = delete;
+		task_graph& operator=(const task_graph&) = delete;
+
+		// Cancels whatever has not finished yet, and waits for the running nodes to return.
+		~task_graph();
+
+		// Nodes can only depend on nodes added before them, so that there can be no cycles.
+		// The node gets scheduled right away if its dependencies have already finished.
+		node_id add(std::function<void(base_task&)> fn, std::span<const node_id> dependencies = {});
+
+		node_id add(std::function<void(base_task&)> fn, std::initializer_list<node_id> dependencies) {
+			return add(std::move(fn), std::span(dependencies.begin(), dependencies.size()));
+		}
+
+		// Cancels the node and everything that depends on it. Running nodes see it through base_task::cancelled.
+		void cancel(node_id id);
+
+		void cancel();
+
+		// Waits until every node has finished, failed or been cancelled, and rethrows the first failure, if any.
+		void wait();
+
+		[[nodiscard]] node_state state(node_id id) const;
+
+		[[nodiscard]] size_t size() const;
+
+		[[nodiscard]] pool& pool() const {
+			return m_pool;
+		}
+
+	private:
+		void run_node(node_id id, task<void>& task);
+
+		void schedule(node_id id);
+
+		void settle(node_id id, node_state state);
+
+		void cancel_subgraph(node_id id);
+
+		void cancel_node(node_id id);
+	};
+
+	// Passes items between nodes that run at the same time, such as stages of a pipeline, holding at most capacity items.
+	// Producers should close the channel when they are done, and either side should cancel it when it stops early, so
+	// that the other side does not wait forever; waits also end once the task of the waiting thread gets cancelled.
+	template<typename T>
+	class bounded_channel {
+		static constexpr auto CancellationPollInterval = std::chrono::milliseconds(10);
+
+		const size_t m_capacity;
+
+		std::mutex m_mtx;
+		std::condition_variable m_cvPushable;
+		std::condition_variable m_cvPoppable;
+		std::deque<T> m_items;
+		bool m_bClosed = false;
+		bool m_bCancelled = false;
+
+	public:
+		bounded_channel(size_t capacity)
+			: m_capacity((std::max<size_t>)(1, capacity)) {
+		}
+
+		bounded_channel(bounded_channel&&) = delete;
+		bounded_channel(const bounded_channel&) = delete;
+		bounded_channel& operator=(bounded_channel&&) = delete;
+		bounded_channel& operator=(const bounded_channel&) = delete;
+
+		// Waits while the channel is full. Returns false if the channel has been closed.
+		bool push(T item) {
+			std::unique_lock lock(m_mtx);
+			wait(lock, m_cvPushable, [this] { return m_bCancelled || m_bClosed || m_items.size() < m_capacity; });
+			if (m_bClosed)
+				return false;
+
+			m_items.emplace_back(std::move(item));
+			m_cvPoppable.notify_one();
+			return true;
+		}
+
+		// Waits while the channel is empty. Returns nothing once the channel has been closed and drained.
+		std::optional<T> pop() {
+			std::unique_lock lock(m_mtx);
+			wait(lock, m_cvPoppable, [this] { return m_bCancelled || m_bClosed || !m_items.empty(); });
+			if (m_items.empty())
+				return std::nullopt;
+
+			std::optional<T> item(std::move(m_items.front()));
+			m_items.pop_front();
+			m_cvPushable.notify_one();
+			return item;
+		}
+
+		void close() {
+			const auto lock = std::lock_guard(m_mtx);
+			m_bClosed = true;
+			m_cvPushable.notify_all();
+			m_cvPoppable.notify_all();
+		}
+
+		// Drops the items held, and makes every push and pop from now on throw cancelled_error.
+		void cancel() {
+			const auto lock = std::lock_guard(m_mtx);
+			m_bCancelled = true;
+			m_items.clear();
+			m_cvPushable.notify_all();
+			m_cvPoppable.notify_all();
+		}
+
+		[[nodiscard]] size_t capacity() const {
+			return m_capacity;
+		}
+
+	private:
+		template<typename TPred>
+		void wait(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, const TPred& pred) {
+			if (!pred()) {
+				auto& currentPool = pool::current();
+				const auto pTask = currentPool.current_task();
+				currentPool.release_working_status([&] {
+					while (!cv.wait_for(lock, CancellationPollInterval, pred)) {
+						if (pTask && pTask->cancelled())
+							break;
+					}
+				});
+				if (pTask)
+					pTask->throw_if_cancelled();
+			}
+
+			if (m_bCancelled)
+				throw cancelled_error();
+		}
+	};
+}
+
+#endif
@@ -1,19 +1,26 @@
 #ifndef XIVRES_INTERNAL_THREADPOOL_H_
 #define XIVRES_INTERNAL_THREADPOOL_H_
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
 #include <ranges>
+#include <shared_mutex>
+#include <stdexcept>
 #include <thread>
 #include <type_traits>
+#include <utility>
 
+#include "util.latency_histogram.h"
 #include "util.listener_manager.h"
 #include "util.on_dtor.h"
 
@@ -40,6 +47,7 @@ namespace xivres::util::thread_pool {
 		invoke_path_type m_invokePath;
 		pool& m_pool;
 		bool m_bCancelled;
+		std::chrono::steady_clock::time_point m_submitTime{};  // only while the pool collects statistics
 
 	public:
 		base_task(pool& pool)
@@ -152,11 +160,104 @@ namespace xivres::util::thread_pool {
 		}
 	};
 
+	// Each thread keeps the objects it returns in a small magazine of its own, so that taking and returning objects mostly
+	// does not touch anything shared with other threads. Full magazines, and magazines of pools a thread has stopped using,
+	// spill into a lock-free list shared by all threads. keepCheck sees the number of objects held across all of them.
 	template<typename T>
 	class object_pool {
-		std::mutex m_mutex;
-		std::vector<std::unique_ptr<T>> m_objects;
-		std::function<bool(size_t, T&)> m_fnKeepCheck;
+		static constexpr size_t MagazineCapacity = 8;
+		static constexpr size_t MagazineSlotCount = 8;
+
+		struct overflow_node {
+			std::unique_ptr<T> Object;
+			overflow_node* Next;
+		};
+
+		// Stays alive for as long as a thread has a magazine for the pool, even after the pool is gone.
+		struct shared_state {
+			std::function<bool(size_t, T&)> KeepCheck;
+
+			// Only ever taken whole, so that popping cannot run into the ABA problem.
+			std::atomic<overflow_node*> Overflow{};
+
+			std::atomic_size_t ObjectCount{};
+			std::atomic_bool Alive{true};
+
+			shared_state(std::function<bool(size_t, T&)> keepCheck)
+				: KeepCheck(std::move(keepCheck)) {
+			}
+
+			~shared_state() {
+				delete_nodes(Overflow.exchange(nullptr, std::memory_order_acquire));
+			}
+
+			void push(std::span<std::unique_ptr<T>> objects) {
+				if (objects.empty())
+					return;
+
+				overflow_node* pFirst = nullptr;
+				overflow_node* pLast = nullptr;
+				for (auto& object : objects) {
+					pFirst = new overflow_node{std::move(object), pFirst};
+					if (!pLast)
+						pLast = pFirst;
+				}
+				push(pFirst, pLast);
+			}
+
+			void push(overflow_node* pFirst, overflow_node* pLast) {
+				pLast->Next = Overflow.load(std::memory_order_relaxed);
+				while (!Overflow.compare_exchange_weak(pLast->Next, pFirst, std::memory_order_release, std::memory_order_relaxed)) {
+					// pass
+				}
+			}
+
+			static void delete_nodes(overflow_node* pNode) {
+				while (pNode)
+					delete std::exchange(pNode, pNode->Next);
+			}
+		};
+
+		struct magazine {
+			std::shared_ptr<shared_state> State;
+			std::vector<std::unique_ptr<T>> Objects;
+			uint64_t LastUse{};
+
+			void flush() {
+				if (State && State->Alive.load(std::memory_order_relaxed))
+					State->push(Objects);
+				Objects.clear();
+				State.reset();
+				LastUse = 0;
+			}
+		};
+
+		// Static pools may outlive the thread cache of the thread that destroys them, such as the main thread on exit.
+		enum class thread_cache_state : uint8_t {
+			unused,
+			alive,
+			destroyed,
+		};
+
+		struct thread_cache {
+			std::array<magazine, MagazineSlotCount> Magazines;
+			uint64_t UseCounter{};
+
+			thread_cache() {
+				s_threadCacheState = thread_cache_state::alive;
+			}
+
+			~thread_cache() {
+				for (auto& magazine : Magazines)
+					magazine.flush();
+				s_threadCacheState = thread_cache_state::destroyed;
+			}
+		};
+
+		static thread_local thread_cache s_threadCache;
+		static thread_local thread_cache_state s_threadCacheState;
+
+		const std::shared_ptr<shared_state> m_state;
 
 	public:
 		class scoped_pooled_object {
@@ -166,38 +267,25 @@ namespace xivres::util::thread_pool {
 			friend class object_pool;
 
 			scoped_pooled_object(object_pool* parent)
-				: m_parent(parent) {
-
-				if (m_parent->m_objects.empty())
-					return;
-
-				const auto lock = std::lock_guard(m_parent->m_mutex);
-				if (m_parent->m_objects.empty())
-					return;
-
-				m_object = std::move(m_parent->m_objects.back());
-				m_parent->m_objects.pop_back();
+				: m_parent(parent)
+				, m_object(parent->take()) {
 			}
 
 		public:
 			scoped_pooled_object() : m_parent(nullptr) {}
 
 			scoped_pooled_object(scoped_pooled_object&& r) noexcept
-				: m_objects(std::move(r.m_object))
-				, m_parent(r.m_parent) {
+				: m_parent(r.m_parent)
+				, m_object(std::move(r.m_object)) {
 				r.m_parent = nullptr;
-				r.m_object.reset();
 			}
 
 			scoped_pooled_object& operator=(scoped_pooled_object&& r) noexcept {
 				if (this == &r)
 					return *this;
 
-				if (m_object && m_parent) {
-					const auto lock = std::lock_guard(m_parent->m_mutex);
-					if (!m_parent->m_fnKeepCheck || m_parent->m_fnKeepCheck(m_parent->m_objects.size(), *m_object))
-						m_parent->m_objects.emplace_back(std::move(m_object));
-				}
+				if (m_object && m_parent)
+					m_parent->give(std::move(m_object));
 
 				m_parent = r.m_parent;
 				m_object = std::move(r.m_object);
@@ -212,11 +300,8 @@ namespace xivres::util::thread_pool {
 			scoped_pooled_object& operator=(const scoped_pooled_object&) = delete;
 
 			~scoped_pooled_object() {
-				if (m_object && m_parent) {
-					const auto lock = std::lock_guard(m_parent->m_mutex);
-					if (!m_parent->m_fnKeepCheck || m_parent->m_fnKeepCheck(m_parent->m_objects.size(), *m_object))
-						m_parent->m_objects.emplace_back(std::move(m_object));
-				}
+				if (m_object && m_parent)
+					m_parent->give(std::move(m_object));
 			}
 
 			operator bool() const {
@@ -239,19 +324,129 @@ namespace xivres::util::thread_pool {
 		};
 
 		object_pool(std::function<bool(size_t, T&)> keepCheck = {})
-			: m_fnKeepCheck(std::move(keepCheck)) {
+			: m_state(std::make_shared<shared_state>(std::move(keepCheck))) {
 		}
 		object_pool(object_pool&&) = delete;
 		object_pool(const object_pool&) = delete;
 		object_pool& operator=(object_pool&&) = delete;
 		object_pool& operator=(const object_pool&) = delete;
-		~object_pool() = default;
+
+		// Magazines of other threads let go of their objects the next time the thread uses a pool of the same type.
+		~object_pool() {
+			m_state->Alive = false;
+			if (s_threadCacheState == thread_cache_state::alive) {
+				for (auto& magazine : s_threadCache.Magazines) {
+					if (magazine.State == m_state)
+						magazine.flush();
+				}
+			}
+			shared_state::delete_nodes(m_state->Overflow.exchange(nullptr, std::memory_order_acquire));
+		}
 
 		scoped_pooled_object operator*() {
 			return { this };
 		}
+
+	private:
+		// Finds the magazine of this thread for this pool, replacing the least recently used one if there is none.
+		// Returns nullptr if the thread cache has already been destroyed.
+		magazine* local_magazine() {
+			if (s_threadCacheState == thread_cache_state::destroyed)
+				return nullptr;
+
+			auto& cache = s_threadCache;
+			cache.UseCounter++;
+
+			magazine* pFound = nullptr;
+			magazine* pLeastRecent = &cache.Magazines[0];
+			for (auto& magazine : cache.Magazines) {
+				if (magazine.State == m_state)
+					pFound = &magazine;
+				else if (magazine.State && !magazine.State->Alive.load(std::memory_order_relaxed))
+					magazine.flush();
+
+				if (magazine.LastUse < pLeastRecent->LastUse)
+					pLeastRecent = &magazine;
+			}
+
+			if (!pFound) {
+				pFound = pLeastRecent;
+				pFound->flush();
+				pFound->State = m_state;
+			}
+			pFound->LastUse = cache.UseCounter;
+			return pFound;
+		}
+
+		std::unique_ptr<T> take() {
+			const auto pMagazine = local_magazine();
+			if (!pMagazine) {
+				auto pNode = m_state->Overflow.exchange(nullptr, std::memory_order_acquire);
+				if (!pNode)
+					return nullptr;
+
+				auto object = std::move(pNode->Object);
+				if (const auto pRest = std::exchange(pNode->Next, nullptr)) {
+					auto pLast = pRest;
+					while (pLast->Next)
+						pLast = pLast->Next;
+					m_state->push(pRest, pLast);
+				}
+				delete pNode;
+
+				m_state->ObjectCount.fetch_sub(1, std::memory_order_relaxed);
+				return object;
+			}
+
+			auto& magazine = *pMagazine;
+			if (magazine.Objects.empty()) {
+				auto pNode = m_state->Overflow.exchange(nullptr, std::memory_order_acquire);
+				for (; pNode && magazine.Objects.size() < MagazineCapacity; delete std::exchange(pNode, pNode->Next))
+					magazine.Objects.emplace_back(std::move(pNode->Object));
+
+				if (pNode) {
+					auto pLast = pNode;
+					while (pLast->Next)
+						pLast = pLast->Next;
+					m_state->push(pNode, pLast);
+				}
+
+				if (magazine.Objects.empty())
+					return nullptr;
+			}
+
+			auto object = std::move(magazine.Objects.back());
+			magazine.Objects.pop_back();
+			m_state->ObjectCount.fetch_sub(1, std::memory_order_relaxed);
+			return object;
+		}
+
+		void give(std::unique_ptr<T> object) {
+			if (m_state->KeepCheck && !m_state->KeepCheck(m_state->ObjectCount.load(std::memory_order_relaxed), *object))
+				return;
+			m_state->ObjectCount.fetch_add(1, std::memory_order_relaxed);
+
+			const auto pMagazine = local_magazine();
+			if (!pMagazine) {
+				m_state->push(std::span(&object, 1));
+				return;
+			}
+
+			auto& magazine = *pMagazine;
+			if (magazine.Objects.size() >= MagazineCapacity) {
+				m_state->push(std::span(magazine.Objects).subspan(MagazineCapacity / 2));
+				magazine.Objects.resize(MagazineCapacity / 2);
+			}
+			magazine.Objects.emplace_back(std::move(object));
+		}
 	};
 
+	template<typename T>
+	thread_local typename object_pool<T>::thread_cache object_pool<T>::s_threadCache;
+
+	template<typename T>
+	thread_local typename object_pool<T>::thread_cache_state object_pool<T>::s_threadCacheState = object_pool<T>::thread_cache_state::unused;
+
 	object_pool<std::vector<uint8_t>>::scoped_pooled_object pooled_byte_buffer();
 
 	struct untyped_task_shared_ptr_comparator {
@@ -263,26 +458,99 @@ namespace xivres::util::thread_pool {
 	class pool {
 		friend class base_task;
 
+		// Tasks are kept in a fixed set of queues, ordered by invoke path. Each worker thread takes from its own queue first,
+		// and then steals from the others, starting from a random one. Tasks submitted from a worker thread go to the queue of
+		// the worker, and the others are spread over the queues in turn.
+		struct task_queue {
+			std::mutex Mtx;
+			std::priority_queue<std::shared_ptr<base_task>, std::vector<std::shared_ptr<base_task>>, untyped_task_shared_ptr_comparator> Tasks;
+		};
+
 		struct thread_info {
 			std::thread Thread;
 			std::shared_ptr<base_task> Task;
+			size_t QueueIndex{};
 		};
 		std::map<std::thread::id, thread_info> m_mapThreads;
+
+		// Set by worker threads for their own use, so that looking up the current task does not need m_mapThreads.
+		static thread_local pool* s_pCurrentPool;
+		static thread_local thread_info* s_pCurrentThreadInfo;
+
 		std::shared_ptr<std::shared_mutex> m_pmtxThread;
 		std::condition_variable_any m_cvThread;
-		size_t m_nConcurrency;
+		std::atomic_size_t m_nConcurrency;
+		std::atomic_size_t m_nThreads;
+		std::atomic_size_t m_nActiveThreads;
 		std::atomic_size_t m_nWaitingThreads;
-		size_t m_nFreeThreads;
-		bool m_bQuitting;
+		std::atomic_size_t m_nFreeThreads;
+		std::atomic_bool m_bQuitting;
 
 		std::chrono::nanoseconds m_durMaxThreadInactivity{ 5000000000LL };  // 5 seconds
 
-		uint64_t m_nTaskCounter = 0;
-		std::priority_queue<std::shared_ptr<base_task>, std::vector<std::shared_ptr<base_task>>, untyped_task_shared_ptr_comparator> m_pqTasks;
+		std::atomic_uint64_t m_nTaskCounter = 0;
+		std::vector<std::unique_ptr<task_queue>> m_queues;
+		std::atomic_size_t m_nQueuedTasks;
+		std::atomic_size_t m_nNextQueueIndex;
+
+		// Guards sleeping and waking up free threads.
 		std::shared_ptr<std::mutex> m_pmtxTask;
 		std::condition_variable m_cvTask;
 
+		// Other than the thread counts, nothing gets recorded unless enabled.
+		struct statistics_state {
+			std::atomic_bool Enabled;
+			std::atomic<std::chrono::steady_clock::rep> Start;
+			std::atomic<std::chrono::steady_clock::rep> LastReport;
+			std::atomic<std::chrono::milliseconds::rep> IntervalMilliseconds;
+
+			std::atomic_uint64_t SubmittedTaskCount;
+			std::atomic_uint64_t CompletedTaskCount;
+			std::atomic_uint64_t CreatedThreadCount;
+			std::atomic_uint64_t ExitedThreadCount;
+			std::atomic_size_t PeakThreadCount;
+			std::atomic_size_t PeakWaitingThreadCount;
+
+			latency_histogram QueueWait;
+			latency_histogram RunTime;
+		} m_statistics;
+
 	public:
+		struct stats {
+			// Since statistics started being collected, or got reset.
+			std::chrono::steady_clock::duration Elapsed{};
+
+			size_t Concurrency{};
+			size_t QueuedTaskCount{};
+			size_t ThreadCount{};
+			size_t PeakThreadCount{};
+			size_t ActiveThreadCount{};
+			size_t FreeThreadCount{};
+
+			// Threads in release_working_status, such as the ones waiting for I/O or for other tasks; the pool starts
+			// other threads in their place.
+			size_t WaitingThreadCount{};
+			size_t PeakWaitingThreadCount{};
+
+			uint64_t SubmittedTaskCount{};
+			uint64_t CompletedTaskCount{};
+			uint64_t CreatedThreadCount{};
+			uint64_t ExitedThreadCount{};
+
+			// From submission to the start of the run.
+			latency_stats QueueWait;
+
+			// Includes the time spent in release_working_status.
+			latency_stats RunTime;
+
+			// Run time over the time that concurrency number of threads could have been running; goes over 1 when tasks spend
+			// time in release_working_status.
+			[[nodiscard]] double utilization() const;
+		};
+
+		// Called from a worker thread after a task, at most once per statistics_interval; never if the interval is zero.
+		listener_manager<pool, void, const stats&> StatisticsCallback;
+
 		pool(size_t nConcurrentExecutions = (std::numeric_limits<size_t>::max)());
 
 		pool(pool&&) = delete;
@@ -303,7 +571,7 @@ namespace xivres::util::thread_pool {
 		template<class Rep, class Period>
 		void max_thread_inactivity(std::chrono::duration<Rep, Period> dur) {
 			m_durMaxThreadInactivity = dur;
-			m_cvTask.notify_all();
+			notify_free_threads(true);
 		}
 
 		std::chrono::nanoseconds max_thread_inactivity() const {
@@ -314,59 +582,79 @@ namespace xivres::util::thread_pool {
 
 		[[nodiscard]] size_t concurrency() const;
 
+		// Enabling resets the statistics collected so far.
+		void collect_statistics(bool enable);
+
+		[[nodiscard]] bool collect_statistics() const;
+
+		void reset_statistics();
+
+		[[nodiscard]] stats statistics() const;
+
+		template<class Rep, class Period>
+		void statistics_interval(std::chrono::duration<Rep, Period> dur) {
+			m_statistics.IntervalMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+		}
+
+		[[nodiscard]] std::chrono::milliseconds statistics_interval() const {
+			return std::chrono::milliseconds(m_statistics.IntervalMilliseconds.load());
+		}
+
 		template<typename TReturn = void>
 		std::shared_ptr<task<TReturn>> submit(std::function<TReturn(task<TReturn>&)> fn) {
-			std::unique_lock lock(*m_pmtxTask);
-
 			auto pTask = std::make_shared<task<TReturn>>(*this, std::move(fn));
 
+			size_t queueIndex;
 			invoke_path_type& invokePath = pTask->m_invokePath;
-			if (const auto it = m_mapThreads.find(std::this_thread::get_id()); it != m_mapThreads.end())
-				invokePath = it->second.Task->m_invokePath;
-			invokePath.Stack[invokePath.Depth] = static_cast<uint16_t>(m_nTaskCounter++);
+			if (const auto pThreadInfo = current_thread_info(); pThreadInfo && pThreadInfo->Task) {
+				invokePath = pThreadInfo->Task->m_invokePath;
+				queueIndex = pThreadInfo->QueueIndex;
+			} else
+				queueIndex = m_nNextQueueIndex++ % m_queues.size();
+			// Once the stack is full, the deepest ones are told apart by the submission order alone.
 			if (invokePath.Depth < invoke_path_type::StackSize)
 				++invokePath.Depth;
+			invokePath.Stack[invokePath.Depth - 1] = static_cast<uint16_t>(m_nTaskCounter++);
 
-			m_pqTasks.emplace(pTask);
-			lock.unlock();
-
-			dispatch_task_to_worker();
+			if (m_statistics.Enabled.load(std::memory_order_relaxed))
+				record_submit(*pTask);
+			push_task(queueIndex, pTask);
 			return pTask;
 		}
 
 		[[nodiscard]] on_dtor release_working_status();
 
 		template<typename TFn>
-		// ReSharper disable once CppNotAllPathsReturnValue
 		decltype(std::declval<TFn>()()) release_working_status(const TFn& fn) {
 			if (!current_task())
 				return fn();
 
-			m_nWaitingThreads += 1;
-			dispatch_task_to_worker();
-			if constexpr (std::is_same_v<decltype(fn()), void>) {
-				fn();
-				m_nWaitingThreads -= 1;
-			} else {
-				auto res = fn();
-				m_nWaitingThreads -= 1;
-				return res;
-			}
+			begin_waiting();
+			const auto waitingEnd = on_dtor([this] { end_waiting(); });
+			return fn();
 		}
 
 	private:
-		void worker_body();
+		void worker_body(size_t queueIndex);
+
+		[[nodiscard]] thread_info* current_thread_info() const;
+
+		void push_task(size_t queueIndex, std::shared_ptr<base_task> pTask);
+
+		// Claims a slot in concurrency and takes a task, first from the given queue, and then from the others.
+		bool take_task(size_t queueIndex, std::shared_ptr<base_task>& pTask);
 
 		void dispatch_task_to_worker();
 
-		bool take_task(std::shared_ptr<base_task>& pTask) {
-			if (m_mapThreads.size() - m_nWaitingThreads >= m_nConcurrency || m_pqTasks.empty())
-				return false;
+		void notify_free_threads(bool all);
 
-			pTask = std::move(const_cast<std::shared_ptr<base_task>&>(m_pqTasks.top()));
-			m_pqTasks.pop();
-			return true;
-		}
+		void begin_waiting();
+
+		void end_waiting();
+
+		void record_submit(base_task& task);
+
+		void record_run(const base_task& task, std::chrono::steady_clock::time_point start);
 	};
 
 	template<typename TFn>
@@ -374,6 +662,60 @@ namespace xivres::util::thread_pool {
 		return m_pool.release_working_status(fn);
 	}
 
+	// Limits how many threads do one kind of work at once, whichever pool they belong to, such as blocking on the disk.
+	// Threads in the lane do not count toward the concurrency of their pool, so that the pool keeps the CPU busy meanwhile.
+	// Threads waiting to enter still do, so that a backed up lane holds back the pool instead of making it start threads.
+	class lane {
+		static thread_local const lane* s_pCurrentLane;
+
+		mutable std::mutex m_mtx;
+		std::condition_variable m_cv;
+		size_t m_nConcurrency;
+		size_t m_nActive = 0;
+
+	public:
+		// Enough requests in flight to keep the queue of a solid state drive busy.
+		static constexpr size_t DefaultIoConcurrency = 16;
+
+		lane(size_t concurrency);
+
+		lane(lane&&) = delete;
+		lane(const lane&) = delete;
+		lane& operator=(lane&&) = delete;
+		lane& operator=(const lane&) = delete;
+
+		~lane() = default;
+
+		// For reading and writing files.
+		static lane& io();
+
+		void concurrency(size_t newConcurrency);
+
+		[[nodiscard]] size_t concurrency() const;
+
+		[[nodiscard]] size_t active() const;
+
+		// Runs fn on the calling thread once the lane has room for it. Calls nested in one for the same lane run right away.
+		template<typename TFn>
+		decltype(std::declval<TFn>()()) run(const TFn& fn) {
+			if (s_pCurrentLane == this)
+				return fn();
+
+			enter();
+			const auto leaving = on_dtor([this, pPrevious = s_pCurrentLane] {
+				s_pCurrentLane = pPrevious;
+				leave();
+			});
+			s_pCurrentLane = this;
+			return pool::current().release_working_status(fn);
+		}
+
+	private:
+		void enter();
+
+		void leave();
+	};
+
 	template<typename TReturn = void>
 	class task_waiter {
 		using TPackagedTask = task<void>;
@@ -384,6 +726,7 @@ namespace xivres::util::thread_pool {
 
 		std::deque<std::future<TReturn>> m_dqFinished;
 		std::condition_variable m_cvFinished;
+		std::deque<std::function<void()>> m_dqReadyCallbacks;
 
 	public:
 		task_waiter(pool& pool = pool::current())
@@ -421,22 +764,33 @@ namespace xivres::util::thread_pool {
 				std::packaged_task<TReturn(base_task&)> task(fn);
 				task(currentTask);
 
-				std::lock_guard lock(m_mtx);
+				std::unique_lock lock(m_mtx);
 				m_mapPending.erase(&currentTask);
 				m_dqFinished.emplace_back(task.get_future());
 				m_cvFinished.notify_one();
+
+				if (!m_dqReadyCallbacks.empty()) {
+					const auto callback = std::move(m_dqReadyCallbacks.front());
+					m_dqReadyCallbacks.pop_front();
+					lock.unlock();
+					callback();
+				}
 			});
 			m_mapPending.emplace(newTask.get(), std::move(newTask));
 		}
 
-		[[nodiscard]] auto get() {
-			if (m_mapPending.empty() && m_dqFinished.empty()) {
-				if constexpr (std::is_void_v<TReturn>)
-					return false;
-				else
-					return std::optional<TReturn>();
-			}
+		// Returns false if get would return without waiting now. Otherwise, returns true, and fn gets called from the thread
+		// that finishes a task next. Each finished task calls one waiting fn, in the order they were given.
+		bool on_next_ready(std::function<void()> fn) {
+			std::lock_guard lock(m_mtx);
+			if (m_mapPending.empty() || !m_dqFinished.empty())
+				return false;
+
+			m_dqReadyCallbacks.emplace_back(std::move(fn));
+			return true;
+		}
 
+		[[nodiscard]] auto get() {
 			std::unique_lock lock(m_mtx);
 			if (m_mapPending.empty() && m_dqFinished.empty()) {
 				if constexpr (std::is_void_v<TReturn>)
@@ -458,13 +812,6 @@ namespace xivres::util::thread_pool {
 
 		template<class Rep, class Period, typename = std::enable_if_t<!std::is_void_v<TReturn>>>
 		[[nodiscard]] auto get(const std::chrono::duration<Rep, Period>& waitDuration) {
-			if (m_mapPending.empty() && m_dqFinished.empty()) {
-				if constexpr (std::is_void_v<TReturn>)
-					return false;
-				else
-					return std::optional<TReturn>();
-			}
-
 			std::unique_lock lock(m_mtx);
 			if (m_mapPending.empty() && m_dqFinished.empty()) {
 				if constexpr (std::is_void_v<TReturn>)
@@ -488,13 +835,6 @@ namespace xivres::util::thread_pool {
 
 		template <class Clock, class Duration, typename = std::enable_if_t<!std::is_void_v<TReturn>>>
 		[[nodiscard]] auto get(const std::chrono::time_point<Clock, Duration>& waitUntil) {
-			if (m_mapPending.empty() && m_dqFinished.empty()) {
-				if constexpr (std::is_void_v<TReturn>)
-					return false;
-				else
-					return std::optional<TReturn>();
-			}
-
 			std::unique_lock lock(m_mtx);
 			if (m_mapPending.empty() && m_dqFinished.empty()) {
 				if constexpr (std::is_void_v<TReturn>)
@@ -525,6 +865,81 @@ namespace xivres::util::thread_pool {
 				void();
 		}
 	};
+
+	// Calls fn for every element of range, in chunks of grain elements; grain of 0 picks one from the concurrency of the pool.
+	// The calling thread takes chunks too, and only waits for the chunks that others have already started, so that it can be
+	// used from inside a task. Once fn throws or the task of the calling thread gets cancelled, the chunks not yet started are
+	// skipped, and the first exception is rethrown.
+	template<std::ranges::random_access_range TRange, typename TFn>
+	void parallel_for(TRange&& range, size_t grain, TFn&& fn, pool& pool = pool::current()) {
+		const auto count = static_cast<size_t>(std::ranges::size(range));
+		if (!count)
+			return;
+		if (!grain)
+			grain = (std::max<size_t>)(1, count / (4 * pool.concurrency()));
+		const auto chunkCount = (count - 1) / grain + 1;
+
+		struct state {
+			std::atomic_size_t NextChunk;
+			std::atomic_size_t DoneChunks;
+			std::atomic_bool Stop;
+			std::mutex Mtx;
+			std::condition_variable Cv;
+			std::exception_ptr Exception;
+		};
+		const auto pState = std::make_shared<state>();
+		const auto pParentTask = pool.current_task();
+
+		// Helpers that get to run only after all chunks are taken return without touching range or fn.
+		const auto work = [pState, pFn = &fn, it = std::ranges::begin(range), count, grain, chunkCount, pParentTask] {
+			auto& s = *pState;
+			for (size_t chunk; (chunk = s.NextChunk++) < chunkCount;) {
+				if (pParentTask && pParentTask->cancelled())
+					s.Stop = true;
+
+				try {
+					for (size_t i = chunk * grain, to = (std::min)(count, i + grain); i < to && !s.Stop; ++i)
+						(*pFn)(it[static_cast<std::ranges::range_difference_t<TRange>>(i)]);
+				} catch (...) {
+					const auto lock = std::lock_guard(s.Mtx);
+					if (!s.Exception)
+						s.Exception = std::current_exception();
+					s.Stop = true;
+				}
+
+				if (++s.DoneChunks == chunkCount) {
+					const auto lock = std::lock_guard(s.Mtx);
+					s.Cv.notify_all();
+				}
+			}
+		};
+
+		for (size_t i = 1, helperCount = (std::min<size_t>)(chunkCount, pool.concurrency()); i < helperCount; ++i)
+			pool.submit<void>([work](task<void>&) { work(); });
+		work();
+
+		if (pState->DoneChunks != chunkCount) {
+			std::unique_lock lock(pState->Mtx);
+			pool.release_working_status([&] { pState->Cv.wait(lock, [&] { return pState->DoneChunks == chunkCount; }); });
+		}
+
+		if (pState->Exception)
+			std::rethrow_exception(pState->Exception);
+		if (pParentTask)
+			pParentTask->throw_if_cancelled();
+	}
+
+	// Stores fn(in[i]) to out[i] for every element of in, as parallel_for does; out must be at least as long as in.
+	template<std::ranges::random_access_range TInRange, std::ranges::random_access_range TOutRange, typename TFn>
+	void parallel_transform(TInRange&& in, TOutRange&& out, size_t grain, TFn&& fn, pool& pool = pool::current()) {
+		const auto count = static_cast<size_t>(std::ranges::size(in));
+		if (static_cast<size_t>(std::ranges::size(out)) < count)
+			throw std::invalid_argument("out is shorter than in");
+
+		parallel_for(std::views::iota(size_t{}, count), grain, [inIt = std::ranges::begin(in), outIt = std::ranges::begin(out), &fn](size_t i) {
+			outIt[static_cast<std::ranges::range_difference_t<TOutRange>>(i)] = fn(inIt[static_cast<std::ranges::range_difference_t<TInRange>>(i)]);
+		}, pool);
+	}
 }
 
 #endif